@@ -1,19 +1,47 @@
 #pragma once
 
+#include <lenny/tools/Cubemap.h>
+
 namespace lenny {
 
+//Dynamic environment map, stored as a cubemap (six sides) or with fewer layers as dual paraboloid (two) or octahedral map (one)
 class DynamicCubemap {
 public:
+    enum MAPPING { CUBE, DUAL_PARABOLOID, OCTAHEDRAL };
+    enum FORMAT { RGB8, R11G11B10F, RGBA16F };  //In ascending precision, the float formats keep HDR values
+
     void create();
+    void createBackTexture();
+    void swapBackTexture();
+    void destroy();
     void checkStatus();
     void startUpdating();
+    void startUpdatingAllSides();
     void stopUpdating();
     glm::mat4 selectSide(int face, glm::vec3 position);
+    static glm::mat4 getSideView(int side, glm::vec3 position);
+    static uint8_t getVisibleSides(glm::vec3 position, glm::vec3 center, float radius);
+    GLenum getTarget() const;
+    static int getNumLayers(MAPPING mapping);
+    size_t getMemorySize() const;
+    static size_t getMemorySize(int width, int height, MAPPING mapping, FORMAT format);
+    static int getBytesPerTexel(FORMAT format);
+    bool readback(tools::Cubemap& cubemap) const;  //Waits for the rendering to finish, only cubemaps are supported
 
-    const int width = 256, height = 256;
+private:
+    void reserveColor(GLenum target);
+    void reserve(GLenum target, GLint internalFormat, GLenum format, GLenum type);
+
+public:
+    MAPPING mapping = CUBE;         //Only change while the cubemap is destroyed
+    FORMAT format = RGB8;           //Only change while the cubemap is destroyed
+    int width = 256, height = 256;  //Only change while the cubemap is destroyed
     GLuint texture = 0;
+    GLuint backTexture = 0;  //Rendered by the worker thread while the texture is sampled, 0 until needed
     GLint previousFramebuffer = 0;
-    GLuint framebuffer = 0;
+    GLuint framebuffer = 0;          //Renders one side at a time
+    GLuint layeredFramebuffer = 0;  //Renders all sides at once
+    GLuint depthTexture = 0;
     GLint viewport[4] = {0, 0, 0, 0};
 };
 
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <lenny/tools/SphericalHarmonics.h>
+
+#include <functional>
+#include <list>
+#include <optional>
+#include <vector>
+
+#include "DynamicCubemap.h"
+
+namespace lenny {
+
+class ReflectionCapturePool {
+public:
+    struct Capture {
+        bool isUsedBy(int modelId) const;
+
+        static constexpr uint8_t ALL_SIDES = 0x3F;
+
+        uint64_t id = 0;
+        DynamicCubemap cubemap;
+        glm::vec3 position = glm::vec3(0);  //View point of the capture
+        std::vector<int> modelIds;          //Models that use this capture (they are hidden in it)
+        uint8_t dirtySides = ALL_SIDES;     //One bit per cubemap side that needs to be re-rendered
+        bool isComplete = false;            //Every side was rendered since the map was created, models use the static cubemap until then
+        uint64_t lastUsedFrame = 0;
+        double screenSize = 0.0;  //Largest projected diameter (in pixels) of its models in the last used frame
+        DynamicCubemap::MAPPING requestedMapping = DynamicCubemap::CUBE;  //Most precise mapping requested by its models in the last used frame
+        DynamicCubemap::FORMAT requestedFormat = DynamicCubemap::RGB8;     //Most precise format requested by its models in the last used frame
+        std::optional<tools::SphericalHarmonics> irradiance = std::nullopt;  //Projected once the capture is complete, reset when the environment changes
+        uint64_t pendingJob = 0;  //Worker job rendering into the back texture, 0 if none
+    };
+
+    //--- Captures
+    Capture* acquire(int modelId, const glm::vec3& position, double screenSize, DynamicCubemap::MAPPING mapping, DynamicCubemap::FORMAT format,
+                     uint64_t frame);
+    void updateMaps(uint64_t frame);
+    void clear();
+
+    //--- Resolutions
+    int getResolution(double screenSize, int currentResolution) const;
+
+    //--- Statistics
+    size_t getUsedMemory() const;
+    size_t getUsedMemory(DynamicCubemap::FORMAT format) const;
+
+public:
+    double memoryBudget = 64.0;    //In MB
+    double sharingDistance = 0.0;  //Models closer than this to a capture's view point share it
+    std::vector<int> resolutions = {32, 64, 128, 256, 512};  //Pooled cubemap resolutions in ascending order
+    double resolutionScale = 0.5;  //Side resolution per pixel of projected diameter (a mirror shows about two sides across)
+    std::list<Capture> captures;
+    uint64_t numEvictions = 0;
+    uint64_t numRejections = 0;  //Requests that did not fit into the budget
+    uint64_t numResizes = 0;
+    std::function<void()> f_waitForJobs;  //Called before a map with a pending job is destroyed, the job may still render into it
+
+private:
+    void use(Capture& capture, double screenSize, DynamicCubemap::MAPPING mapping, DynamicCubemap::FORMAT format, uint64_t frame);
+    void detach(Capture& capture, int modelId);
+    bool makeRoom(size_t size, uint64_t frame);
+    void destroyMap(Capture& capture);
+
+private:
+    uint64_t nextId = 1;
+};
+
+}  // namespace lenny
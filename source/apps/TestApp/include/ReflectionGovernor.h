@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+namespace lenny {
+
+//Steps the reflection quality down when the frame rate drops below the target and probes the next level up once it held the target for a while.
+//Reflections degrade before the frame rate does, a level that failed again soon after an upgrade doubles the delay until the next probe
+class ReflectionGovernor {
+public:
+    struct Level {
+        const char* name;
+        double resolutionScale;  //Of the capture pool
+        double timeBudget;       //GPU time of the scheduler in milliseconds, i.e. the update rate of the captures
+        float proxyThreshold;    //Fraction of the indices kept in the proxy meshes
+    };
+
+    //--- Control (once per frame, returns true if the level changed or has to be applied after enabling)
+    bool update(double frameTime, double targetFrameTime, double captureTime);  //Times in seconds, the capture time in milliseconds of GPU time
+
+    //--- Gui
+    const Level& getLevel() const;
+    void drawGui();
+
+public:
+    bool isEnabled = false;
+    std::vector<Level> levels = {
+        {"Lowest", 0.125, 0.5, 0.02f}, {"Low", 0.25, 1.0, 0.05f}, {"Medium", 0.5, 2.0, 0.1f}, {"High", 0.75, 4.0, 0.2f}, {"Highest", 1.0, 8.0, 0.4f}};
+    int level = 2;                  //Medium matches the defaults of the pool, scheduler and proxies
+    double tolerance = 0.05;        //Relative frame time above the target that still counts as holding it
+    double reactionTime = 0.25;     //Seconds above the target before stepping down
+    double upgradeDelay = 2.0;      //Seconds at the target before probing the next level
+    double maxCaptureShare = 0.25;  //Largest share of the target frame time the captures of the next level may take on the GPU
+    double cooldown = 0.5;          //Seconds after a change that are not measured
+
+    //Statistics
+    double smoothedFrameTime = 0.0;  //In seconds
+    int numDowngrades = 0, numUpgrades = 0;
+
+private:
+    void startCooldown();
+
+private:
+    bool wasEnabled = false;
+    double timeSinceChange = 0.0;
+    double timeAbove = 0.0, timeBelow = 0.0;  //Seconds the smoothed frame time stayed above or at the target
+    double currentUpgradeDelay = upgradeDelay;
+    double timeSinceUpgrade = 0.0;
+};
+
+}  // namespace lenny
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <list>
+
+#include "ReflectionCapturePool.h"
+
+namespace lenny {
+
+//Fixed set of reflection probes on a regular grid, shared by all models instead of one capture per model
+class ReflectionProbeGrid {
+public:
+    static constexpr int MAX_BLENDED_PROBES = 4;  //Matches the probe samplers in shader.frag
+
+    struct Blend {
+        std::array<const ReflectionCapturePool::Capture*, MAX_BLENDED_PROBES> probes = {};
+        std::array<float, MAX_BLENDED_PROBES> weights = {};
+        int numProbes = 0;
+
+        Blend getComplete() const;  //Without the probes that were not rendered completely yet, none if no weight is left
+    };
+
+    struct Occluder {
+        int modelId;
+        glm::vec3 center;  //Bounding sphere
+        float radius;
+    };
+
+    //--- Probes
+    void create();
+    void destroy();
+    void use(uint64_t frame, const std::vector<Occluder>& models);  //Each model is hidden in the probes inside its bounding sphere
+    Blend getBlend(const glm::vec3& position) const;
+
+    //--- Statistics
+    size_t getUsedMemory() const;
+    size_t getUsedMemory(DynamicCubemap::FORMAT format) const;
+
+    //--- Gui
+    void drawGui();
+
+public:
+    glm::vec3 minimum = glm::vec3(-2.5f, 0.25f, -1.5f);
+    glm::vec3 maximum = glm::vec3(2.5f, 2.0f, 1.5f);
+    glm::ivec3 numProbes = glm::ivec3(4, 2, 2);
+    int resolution = 128;
+    DynamicCubemap::FORMAT format = DynamicCubemap::RGB8;
+    std::list<ReflectionCapturePool::Capture> probes;
+    std::function<void()> f_waitForJobs;  //Called before probes with pending jobs are destroyed, the jobs may still render into them
+};
+
+}  // namespace lenny
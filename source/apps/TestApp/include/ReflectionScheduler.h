@@ -0,0 +1,57 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "ReflectionCapturePool.h"
+
+namespace lenny {
+
+class ReflectionScheduler {
+public:
+    //Renders one side of a capture, or all of its sides if the side is ALL
+    typedef std::function<void(ReflectionCapturePool::Capture& capture, int side)> F_renderCapture;
+    static constexpr int ALL = -1;
+
+    ~ReflectionScheduler();
+
+    void update(std::list<ReflectionCapturePool::Capture>& captures, uint64_t frame, const F_renderCapture& f_renderCapture);
+    ReflectionCapturePool::Capture* takeNextCapture(std::list<ReflectionCapturePool::Capture>& captures, uint64_t frame);  //For rendering elsewhere
+    void measureCaptures(const std::vector<double>& captureTimes);  //GPU times of the captures rendered elsewhere that finished this frame
+    void drawGui();
+
+public:
+    bool limitTime = true;
+    double timeBudget = 2.0;  //In milliseconds of GPU time per frame
+
+    //Statistics
+    int renderedSides = 0, renderedCaptures = 0, pendingSides = 0;
+    double sideTime = 0.5, captureTime = 2.0;  //Running averages in milliseconds
+    double measuredFrameTime = 0.0;            //GPU time of the last fully measured frame in milliseconds, 0 if it rendered no captures
+
+private:
+    ReflectionCapturePool::Capture* getNextCapture(std::list<ReflectionCapturePool::Capture>& captures, uint64_t frame) const;
+    GLuint beginQuery();
+    void collectQueryResults();
+
+private:
+    struct Query {
+        GLuint id;
+        uint64_t frame;
+        bool isCapture;  //All sides or a single side
+    };
+    struct FrameTime {
+        uint64_t frame;
+        int numPendingQueries;
+        double time;  //Sum of the collected queries
+    };
+    std::deque<Query> pendingQueries;
+    std::deque<FrameTime> pendingFrames;  //Published once all of their queries are collected
+    std::vector<GLuint> freeQueries;
+    uint64_t lastCaptureId = 0;  //Round-robin position
+    uint64_t takenFrame = 0;     //Captures taken for rendering elsewhere in this frame, and their estimated time
+    double takenTime = 0.0;
+};
+
+}  // namespace lenny
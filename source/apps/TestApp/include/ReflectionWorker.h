@@ -0,0 +1,66 @@
+#pragma once
+
+#include <lenny/gui/Shader.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lenny {
+
+//Renders reflection captures on a second thread, with a hidden window whose context shares the textures and buffers of the main context.
+//A job starts once the GPU finished the main context's commands before its submission, and is handed back with a fence of the worker context
+class ReflectionWorker {
+public:
+    //Renders with the worker context current, into the given framebuffer of the worker context
+    typedef std::function<void(GLuint framebuffer)> F_render;
+
+    struct Finished {
+        uint64_t id;
+        double gpuTime;  //Of the job in milliseconds
+    };
+
+    ~ReflectionWorker();
+
+    //--- Thread (called from the main thread with the main context current)
+    void start();
+    void stop();
+    bool isRunning() const;
+
+    //--- Jobs (main thread)
+    void submit(uint64_t jobId, const F_render& f_render);
+    std::vector<Finished> collectFinished();  //Jobs whose results are visible to the main context, never blocks
+    void waitUntilIdle();                     //Call before changing anything the submitted jobs read
+    int getNumPending() const;                //Submitted jobs that were not collected yet
+
+private:
+    void run();
+
+private:
+    struct Job {
+        uint64_t id;
+        GLsync ready;  //Of the main context
+        F_render f_render;
+    };
+    struct Result {
+        uint64_t id;
+        GLsync done;  //Of the worker context
+        double gpuTime;
+    };
+
+    GLFWwindow* window = nullptr;
+    std::vector<gui::Shader> shaders;  //Programs of the worker thread, kept with the context between runs
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable jobAdded, jobFinished;
+    std::deque<Job> jobs;
+    std::deque<Result> results;
+    int numPending = 0;
+    bool isBusy = false;
+    bool stopRequested = false;
+};
+
+}  // namespace lenny
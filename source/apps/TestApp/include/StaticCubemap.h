@@ -1,12 +1,32 @@
 #pragma once
 
+#include <lenny/tools/CubemapContainer.h>
+
 namespace lenny {
 
 class StaticCubemap {
 public:
-    void load(std::vector<std::string>& filenames);
+    //--- Sources (faces of the base level in OpenGL order)
+    static tools::Cubemap loadFaces(const std::vector<std::string>& filenames);
+    static tools::Cubemap loadEquirectangular(const std::string& filename, int faceSize = 0);  //.hdr or 8-bit image
+    static bool isEquirectangular(const std::string& filename);                                //Without decoding the pixels
+    static std::vector<std::string> getFaceFilenames(const std::string& folder);  //right, left, top, bottom, front and back.png
+    static uint64_t getSourceKey(const std::vector<std::string>& filenames);       //From the paths, sizes and modification times
+
+    //--- Container (roughness-prefiltered mip chain and irradiance in the upload format)
+    bool convert(const tools::Cubemap& faces, const std::string& containerPath, uint64_t sourceKey) const;
+    bool load(const std::string& containerPath, uint64_t sourceKey);  //Fails if the container is missing or of other sources or settings
+    void destroy();
+    bool readback(tools::Cubemap& cubemap) const;  //Prefiltered mip chain of the uploaded texture
 
+private:
+    uint64_t getKey(uint64_t sourceKey) const;
+
+public:
     GLuint texture = 0;
+    int numLevels = 6;      //Level i holds roughness i / (numLevels - 1)
+    int numSamples = 128;  //GGX samples per texel
+    tools::SphericalHarmonics irradiance;  //Of the unfiltered faces
 };
 
-}  // namespace lenny
\ No newline at end of file
+}  // namespace lenny
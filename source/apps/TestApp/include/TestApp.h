@@ -2,10 +2,20 @@
 
 #include <lenny/gui/Application.h>
 #include <lenny/gui/Model.h>
+#include <lenny/gui/ModelLoader.h>
+#include <lenny/tools/PathTracer.h>
+#include <lenny/tools/Timer.h>
 
 #include "DynamicCubemap.h"
+#include "ReflectionCapturePool.h"
+#include "ReflectionGovernor.h"
+#include "ReflectionProbeGrid.h"
+#include "ReflectionScheduler.h"
+#include "ReflectionWorker.h"
 #include "StaticCubemap.h"
 
+#include <future>
+
 namespace lenny {
 
 class TestApp : public gui::Application {
@@ -30,34 +40,173 @@ public:
     bool enableEnvironmentMapping = true;
     bool enableDynamicReflections = true;
     int environmentMappingType = 3;
+    float reflectionRoughness = 0.0f;
+    bool useIrradiance = false;  //Ambient light from the spherical harmonics of the environment
 
     struct AppModel {
         AppModel(const std::string& filePath, const Eigen::Vector3d& position, const Eigen::QuaternionD& orientation, const double& scale)
-            : mesh(filePath), position(position), orientation(orientation), scale(scale * Eigen::Vector3d::Ones()) {}
+            : id(nextId++), mesh(filePath), position(position), orientation(orientation), scale(scale * Eigen::Vector3d::Ones()) {}
+        AppModel(const std::string& filePath, gui::Model::Data&& data, const Eigen::Vector3d& position, const Eigen::QuaternionD& orientation,
+                 const double& scale)
+            : id(nextId++), mesh(filePath, std::move(data)), position(position), orientation(orientation), scale(scale * Eigen::Vector3d::Ones()) {}
+
+        bool updateChangeState();
 
+        int id;  //Key of the model's reflection capture
         gui::Model mesh;
         Eigen::Vector3d position;
         Eigen::QuaternionD orientation;
         Eigen::Vector3d scale;
+        DynamicCubemap::MAPPING captureMapping = DynamicCubemap::CUBE;  //Trades precision for fewer capture passes
+        DynamicCubemap::FORMAT captureFormat = DynamicCubemap::RGB8;     //Trades range and precision for memory and bandwidth
+        float proxyThreshold = 0.f;  //Of the generated proxy meshes
+
+        //Change tracking (transform at the last detected change)
+        bool hasChanged = true;
+        bool isTracked = false;
+        Eigen::Vector3d trackedPosition = Eigen::Vector3d::Zero();
+        Eigen::QuaternionD trackedOrientation = Eigen::QuaternionD::Identity();
+        Eigen::Vector3d trackedScale = Eigen::Vector3d::Ones();
+
+        inline static int nextId = 0;
+    };
+    std::vector<AppModel> models;
+    gui::ModelLoader modelLoader;  //Imports and decodes on all cores, the models are created on the main thread
+    void loadDefaultModels();
+
+    //Dropped models, drawn as placeholders until they are loaded
+    struct PendingModel {
+        uint64_t ticket;
+        std::string filePath;
+        Eigen::Vector3d position;
     };
-    std::vector<AppModel> models = {
-        AppModel(LENNY_GUI_TESTAPP_FOLDER "/config/yumi/Base.obj", Eigen::Vector3d(-1.0, 0.5, 0.0),
-                 Eigen::QuaternionD(tools::utils::rotY(-PI / 2.0) * tools::utils::rotX(-PI / 2.0)), 1.0),
-        AppModel(LENNY_GUI_TESTAPP_FOLDER "/config/gripper/Gripper.obj", Eigen::Vector3d(-0.5, 0.5, 0.0), Eigen::QuaternionD::Identity(), 3.0),
-        AppModel(LENNY_GUI_TESTAPP_FOLDER "/config/nao/12211_Robot_l2.obj", Eigen::Vector3d(0.0, 0.5, 0.0), Eigen::QuaternionD(tools::utils::rotX(-PI / 2.0)),
-                 0.03),
-        AppModel(LENNY_GUI_TESTAPP_FOLDER "/config/widowx/Base.stl", Eigen::Vector3d(0.5, 0.5, 0.0), Eigen::QuaternionD(tools::utils::rotX(-PI / 2.0)), 0.003),
-        AppModel(LENNY_GUI_TESTAPP_FOLDER "/config/spot/Body.dae", Eigen::Vector3d(1.0, 0.5, 0.0), Eigen::QuaternionD::Identity(), 1.0),
-        AppModel(LENNY_GUI_OPENGL_FOLDER "/data/meshes/sphere.obj", Eigen::Vector3d(-2, 1, 1), Eigen::QuaternionD::Identity(), 2.0)};
+    std::vector<PendingModel> pendingModels;
+    void updatePendingModels();  //Swaps in the finished models
+    void drawPendingModels() const;
+    Eigen::Vector3d getDropPosition(double spacing = 1.0) const;  //First spot along x that is free of models and placeholders
     AppModel* selectedModel = nullptr;
 
     //Environment mapping
-    std::vector<gui::Model::Mesh> skybox;
+    std::optional<gui::Model::Mesh> skybox = std::nullopt;
     StaticCubemap staticCubemap;
-    DynamicCubemap dynamicCubemap;
-    void loadSkybox(std::vector<std::string>& filenames);
-    void drawSkybox() const;
-    void updateDynamicCubemap(int modelIndex);
+    void loadEnvironment(const std::string& equirectangularPath);  //The six default faces if empty
+    void loadSkybox();
+    void drawSkybox(const glm::vec3& viewPoint) const;  //After the opaque models, it is drawn at maximum depth
+    float getEnvironmentLod() const;
+    static void setIrradiance(const tools::SphericalHarmonics& irradiance, bool isEnabled);
+
+    //Reflection captures
+    ReflectionCapturePool capturePool;
+    ReflectionScheduler scheduler;
+    ReflectionProbeGrid probeGrid;
+    bool useProbeGrid = false;  //Blend the nearest probes of a fixed grid instead of one capture per model
+    uint64_t frame = 0;
+    bool useLayeredRendering = true;
+    bool useProxyMeshes = true;
+    float proxyThreshold = 0.1f;                   //Fraction of the indices kept in the proxy meshes
+    float editedProxyThreshold = proxyThreshold;  //Of the gui slider, applied once it is released
+    float proxyTargetError = 0.05f;                //Relative simplification error
+    void updateProxyMeshes();  //Regenerates missing or outdated proxies of one model per frame
+    void updateReflectionCapture(ReflectionCapturePool::Capture& capture, int side);
+    double getScreenSize(int modelIndex) const;
+    std::list<ReflectionCapturePool::Capture>& getActiveCaptures();
+    void updateIrradiance();
+    tools::SphericalHarmonics getIrradiance(const ReflectionCapturePool::Capture* capture, const glm::vec3& position) const;
+
+    //Everything a capture pass reads, copied on the main thread so the pass can also run on the worker
+    struct CapturePass {
+        struct Item {
+            const gui::Model* model;
+            Eigen::Vector3d position;
+            Eigen::QuaternionD orientation;
+            Eigen::Vector3d scale;
+            uint8_t visibleSides;  //Of the rendered sides
+        };
+
+        DynamicCubemap cubemap;  //Handles only, the worker renders into the back texture
+        glm::vec3 position;
+        int side;
+        bool useLayeredRendering;
+
+        gui::Light light;
+        bool enableEnvironmentMapping, useIrradiance;
+        int environmentMappingType;
+        float environmentLod;
+        GLuint environmentTexture;
+        tools::SphericalHarmonics irradiance;
+
+        std::vector<Item> items;
+        std::optional<Eigen::Vector3d> modelColor = std::nullopt;
+        double alpha;
+        bool useProxyMeshes;
+    };
+    CapturePass getCapturePass(const ReflectionCapturePool::Capture& capture, int side) const;
+    void renderCapturePass(CapturePass& pass) const;
+    void drawReflectedScene(const CapturePass& pass, uint8_t sides) const;
+
+    //Background capture rendering (declared after the models, so it stops before they are destroyed)
+    ReflectionWorker worker;
+    bool useWorkerThread = false;
+    int maxPendingJobs = 2;  //Captures in flight, more hide the latency but publish older results
+    uint64_t nextJobId = 1;
+    void submitReflectionCapture(ReflectionCapturePool::Capture& capture);
+    void updateCapturesOnWorker();
+    void stopWorker();  //Pending captures are marked dirty for the main thread
+
+    //Quality of the reflections adapted to the target frame rate
+    ReflectionGovernor governor;
+    void updateQualityGovernor();
+
+    //Path-traced ground truth of the current view, rendered on a background thread and compared with the rasterized image once done
+    struct ReferenceJob {
+        ~ReferenceJob() { pathTracer.stop(); }  //Before the future waits for the render
+
+        tools::PathTracer pathTracer;
+        tools::Cubemap environment;  //Read back from the static cubemap, the path tracer points to it
+        tools::PathTracer::Image rasterized;
+        std::string filePath;
+        int width = 0, height = 0;
+        tools::Timer timer;
+        std::future<tools::PathTracer::Image> image;
+    };
+    int referenceSamples = 16;                             //Per pixel
+    double referenceError = -1.0;                          //RMSE of the last comparison, negative if there is none
+    std::unique_ptr<ReferenceJob> referenceJob = nullptr;  //Null if no render is running
+    void renderReference();                                //Starts a job with the scene as it is now
+    void updateReference();                                //Saves and compares the image of a finished job
+
+    //Software rasterization of the current view, compared with a GPU frame drawn without what the rasterizer does not reproduce
+    struct RasterizerComparison {
+        uint64_t frame = 0;  //Compared once this frame is drawn
+        bool showGround = true, showOrigin = true, enableDynamicReflections = true;  //Restored afterwards
+    };
+    double rasterizerError = -1.0;  //RMSE of the last comparison, negative if there is none
+    std::optional<RasterizerComparison> rasterizerComparison = std::nullopt;
+    void requestRasterizerComparison();  //Hides the ground, the origin and the dynamic captures for the next frame
+    void rasterizeOnCpu();
+    bool saveScreenshot(const std::string& filePath, std::vector<Eigen::Array4f>& image, int& width, int& height) const;  //First row at the bottom
+    static bool saveImage(const std::string& filePath, std::vector<Eigen::Array4f>& image, int width, int height);  //Clamps the image to [0, 1]
+
+    //Change tracking of everything that is visible in the reflection captures
+    struct CaptureSettings {
+        Eigen::Vector4d rendererColor;
+        bool showMaterials, showReferenceSphere, enableEnvironmentMapping, useProxyMeshes, useIrradiance;
+        int environmentMappingType;
+        float reflectionRoughness;
+        Eigen::Vector3d lightPosition, lightColor;
+        double lightColorIntensity, lightGlowIntensity;
+        float ambientStrength, diffuseStrength, specularStrength;
+
+        bool operator==(const CaptureSettings& other) const = default;
+    };
+    CaptureSettings getCaptureSettings() const;
+    bool isVisibleInCaptures(int modelIndex) const;
+    void updateChangeTracking();
+    std::optional<CaptureSettings> lastCaptureSettings = std::nullopt;
+
+    //Capture statistics (per frame and accumulated)
+    int executedCaptures = 0, skippedCaptures = 0;
+    uint64_t totalExecutedCaptures = 0, totalSkippedCaptures = 0;
 };
 
 }  // namespace lenny
\ No newline at end of file
@@ -8,41 +8,102 @@
 namespace lenny {
 
 void DynamicCubemap::create() {
-    //Create a new cubemap texture
+    const GLenum target = getTarget();
+
+    //Create a new color texture
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glBindTexture(target, texture);
 
     //Reserve textures
-    for (int side = 0; side < 6; side++)
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    reserveColor(target);
 
-    //Set texture parameters
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    //Create a new framebuffer
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    //Create a new depth texture of the same shape (layered rendering needs a layered depth attachment)
+    glGenTextures(1, &depthTexture);
+    glBindTexture(target, depthTexture);
+    reserve(target, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    //Create a new framebuffer for single sides, only cubemaps are rendered side by side
+    if (mapping == CUBE) {
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        //Attach the color and depth buffers of the first side
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, texture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, depthTexture, 0);
 
-    //Create a new depth buffer
-    GLuint depthbuffer = 0;
-    glGenRenderbuffers(1, &depthbuffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        //Check for framebuffer errors
+        checkStatus();
+    }
 
-    //Attach the color and depth buffers
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, texture, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebuffer);
+    //Create a new framebuffer for all sides, the whole textures are attached once
+    glGenFramebuffers(1, &layeredFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, layeredFramebuffer);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
 
     //Check for framebuffer errors
     checkStatus();
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glBindTexture(target, 0);
+}
+
+void DynamicCubemap::createBackTexture() {
+    const GLenum target = getTarget();
+    glGenTextures(1, &backTexture);
+    glBindTexture(target, backTexture);
+    reserveColor(target);
+    glBindTexture(target, 0);
+}
+
+void DynamicCubemap::swapBackTexture() {
+    std::swap(texture, backTexture);
+
+    //The layered framebuffer keeps its attachment, single sides are attached when they are selected
+    GLint currentFramebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &currentFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, layeredFramebuffer);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, currentFramebuffer);
+}
+
+void DynamicCubemap::reserveColor(GLenum target) {
+    if (format == RGBA16F)
+        reserve(target, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+    else if (format == R11G11B10F)
+        reserve(target, GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT);
+    else
+        reserve(target, GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE);
+
+    //Set texture parameters
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void DynamicCubemap::reserve(GLenum target, GLint internalFormat, GLenum format, GLenum type) {
+    if (target == GL_TEXTURE_CUBE_MAP) {
+        for (int side = 0; side < 6; side++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, 0, internalFormat, width, height, 0, format, type, 0);
+    } else if (target == GL_TEXTURE_2D_ARRAY) {
+        glTexImage3D(target, 0, internalFormat, width, height, getNumLayers(mapping), 0, format, type, 0);
+    } else {
+        glTexImage2D(target, 0, internalFormat, width, height, 0, format, type, 0);
+    }
+}
+
+void DynamicCubemap::destroy() {
+    //Release the GPU resources
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteFramebuffers(1, &layeredFramebuffer);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &texture);
+    glDeleteTextures(1, &backTexture);
+    framebuffer = layeredFramebuffer = depthTexture = texture = backTexture = 0;
 }
 
 void DynamicCubemap::checkStatus() {
@@ -91,6 +152,19 @@ void DynamicCubemap::startUpdating() {
     glViewport(0, 0, width, height);
 }
 
+void DynamicCubemap::startUpdatingAllSides() {
+    //Store the current framebuffer binding and bind the layered cubemap framebuffer
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, layeredFramebuffer);
+
+    //Store the current viewport and set the cubemap viewport
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(0, 0, width, height);
+
+    //Clear all sides at once
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
 void DynamicCubemap::stopUpdating() {
 
     //restore the previous framebuffer binding
@@ -101,13 +175,18 @@ void DynamicCubemap::stopUpdating() {
 }
 
 glm::mat4 DynamicCubemap::selectSide(int side, glm::vec3 position) {
-    //Attach the texture to the framebuffer
+    //Attach the textures to the framebuffer
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, side, texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, side, depthTexture, 0);
     checkStatus();
 
     //Clear the cubemap viewport
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    return getSideView(side, position);
+}
+
+glm::mat4 DynamicCubemap::getSideView(int side, glm::vec3 position) {
     //Create the view matrix for each side
     glm::mat4 view(1.0f);
     switch (side)
@@ -137,4 +216,75 @@ glm::mat4 DynamicCubemap::selectSide(int side, glm::vec3 position) {
     return view;
 }
 
+uint8_t DynamicCubemap::getVisibleSides(glm::vec3 position, glm::vec3 center, float radius) {
+    //Each side sees a 90-degree pyramid around its axis, bounded by the planes |other axis| = main axis
+    const glm::vec3 p = center - position;
+    const float offset = radius * std::sqrt(2.0f);
+    uint8_t sides = 0;
+    for (int side = 0; side < 6; side++) {
+        const int axis = side / 2;
+        const float depth = (side % 2 == 0) ? p[axis] : -p[axis];
+        const float u = p[(axis + 1) % 3], v = p[(axis + 2) % 3];
+        if (depth - std::abs(u) >= -offset && depth - std::abs(v) >= -offset)
+            sides |= (1 << side);
+    }
+    return sides;
+}
+
+GLenum DynamicCubemap::getTarget() const {
+    switch (mapping) {
+        case DUAL_PARABOLOID:
+            return GL_TEXTURE_2D_ARRAY;
+        case OCTAHEDRAL:
+            return GL_TEXTURE_2D;
+        default:
+            return GL_TEXTURE_CUBE_MAP;
+    }
+}
+
+int DynamicCubemap::getNumLayers(MAPPING mapping) {
+    switch (mapping) {
+        case DUAL_PARABOLOID:
+            return 2;
+        case OCTAHEDRAL:
+            return 1;
+        default:
+            return 6;
+    }
+}
+
+size_t DynamicCubemap::getMemorySize() const {
+    const size_t backTextureSize = backTexture ? (size_t)width * height * getNumLayers(mapping) * getBytesPerTexel(format) : 0;
+    return getMemorySize(width, height, mapping, format) + backTextureSize;
+}
+
+size_t DynamicCubemap::getMemorySize(int width, int height, MAPPING mapping, FORMAT format) {
+    //Color and depth layers
+    return (size_t)width * height * getNumLayers(mapping) * (getBytesPerTexel(format) + 4);
+}
+
+int DynamicCubemap::getBytesPerTexel(FORMAT format) {
+    //Drivers pad RGB8 to 4 bytes per texel, so it costs as much as the packed float format
+    switch (format) {
+        case RGBA16F:
+            return 8;
+        default:
+            return 4;
+    }
+}
+
+bool DynamicCubemap::readback(tools::Cubemap& cubemap) const {
+    if (mapping != CUBE || texture == 0 || width != height)
+        return false;
+
+    //The texels of tools::Cubemap are tightly packed float RGBA
+    cubemap = tools::Cubemap(width);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (int side = 0; side < 6; side++)
+        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, 0, GL_RGBA, GL_FLOAT, cubemap.getFace(0, side));
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    return true;
+}
+
 }  // namespace lenny
\ No newline at end of file
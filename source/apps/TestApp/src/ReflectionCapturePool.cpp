@@ -0,0 +1,183 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <lenny/tools/Logger.h>
+#include "ReflectionCapturePool.h"
+
+#include <algorithm>
+
+namespace lenny {
+
+bool ReflectionCapturePool::Capture::isUsedBy(int modelId) const {
+    return std::find(modelIds.begin(), modelIds.end(), modelId) != modelIds.end();
+}
+
+ReflectionCapturePool::Capture* ReflectionCapturePool::acquire(int modelId, const glm::vec3& position, double screenSize, DynamicCubemap::MAPPING mapping,
+                                                               DynamicCubemap::FORMAT format, uint64_t frame) {
+    //Keep the model's current capture if it still fits the model's position
+    for (Capture& capture : captures) {
+        if (!capture.isUsedBy(modelId))
+            continue;
+
+        if (capture.modelIds.size() == 1) {
+            //An exclusive capture follows its model
+            if (capture.position != position) {
+                capture.position = position;
+                capture.dirtySides = Capture::ALL_SIDES;
+            }
+            use(capture, screenSize, mapping, format, frame);
+            return &capture;
+        }
+        if (glm::distance(capture.position, position) <= (float)sharingDistance) {
+            use(capture, screenSize, mapping, format, frame);
+            return &capture;
+        }
+
+        //The model moved away from a shared capture
+        detach(capture, modelId);
+        break;
+    }
+
+    //Share a capture whose view point is close enough
+    if (sharingDistance > 0.0) {
+        for (Capture& capture : captures) {
+            if (glm::distance(capture.position, position) <= (float)sharingDistance) {
+                capture.modelIds.emplace_back(modelId);
+                use(capture, screenSize, mapping, format, frame);
+                capture.dirtySides = Capture::ALL_SIDES;  //The new model needs to be hidden in the capture
+                return &capture;
+            }
+        }
+    }
+
+    //Create a new capture within the memory budget
+    Capture capture;
+    capture.cubemap.mapping = mapping;
+    capture.cubemap.format = format;
+    capture.cubemap.width = capture.cubemap.height = getResolution(screenSize, 0);
+    if (!makeRoom(capture.cubemap.getMemorySize(), frame)) {
+        numRejections++;
+        return nullptr;
+    }
+    capture.cubemap.create();
+    capture.id = nextId++;
+    capture.position = position;
+    capture.modelIds = {modelId};
+    use(capture, screenSize, mapping, format, frame);
+    captures.emplace_back(capture);
+    return &captures.back();
+}
+
+void ReflectionCapturePool::updateMaps(uint64_t frame) {
+    //Called after all captures of a frame are acquired, so shared captures know the requests of all their models
+    for (Capture& capture : captures) {
+        if (capture.lastUsedFrame != frame)
+            continue;
+
+        const int resolution = getResolution(capture.screenSize, capture.cubemap.width);
+        const DynamicCubemap::MAPPING mapping = capture.requestedMapping;
+        const DynamicCubemap::FORMAT format = capture.requestedFormat;
+        if (resolution == capture.cubemap.width && mapping == capture.cubemap.mapping && format == capture.cubemap.format)
+            continue;
+
+        //Growing needs room within the budget, otherwise the capture keeps its map
+        const size_t size = DynamicCubemap::getMemorySize(resolution, resolution, mapping, format);
+        const size_t currentSize = capture.cubemap.getMemorySize();
+        if (size > currentSize && !makeRoom(size - currentSize, frame)) {
+            numRejections++;
+            continue;
+        }
+
+        //Recreate the map with the new resolution, mapping and format
+        destroyMap(capture);
+        capture.cubemap.mapping = mapping;
+        capture.cubemap.format = format;
+        capture.cubemap.width = capture.cubemap.height = resolution;
+        capture.cubemap.create();
+        capture.dirtySides = Capture::ALL_SIDES;
+        capture.isComplete = false;
+        numResizes++;
+    }
+}
+
+void ReflectionCapturePool::clear() {
+    for (Capture& capture : captures)
+        destroyMap(capture);
+    captures.clear();
+}
+
+int ReflectionCapturePool::getResolution(double screenSize, int currentResolution) const {
+    //Smallest pooled resolution that covers the scaled screen size
+    const double requiredSize = screenSize * resolutionScale;
+    int index = 0;
+    while (index + 1 < (int)resolutions.size() && resolutions[index] < requiredSize)
+        index++;
+
+    //Only drop a level once the required size is clearly below the lower resolution, so captures don't flip at the boundary
+    if (resolutions[index] < currentResolution && requiredSize > 0.8 * resolutions[index])
+        index++;
+    return resolutions[index];
+}
+
+size_t ReflectionCapturePool::getUsedMemory() const {
+    size_t size = 0;
+    for (const Capture& capture : captures)
+        size += capture.cubemap.getMemorySize();
+    return size;
+}
+
+size_t ReflectionCapturePool::getUsedMemory(DynamicCubemap::FORMAT format) const {
+    size_t size = 0;
+    for (const Capture& capture : captures)
+        if (capture.cubemap.format == format)
+            size += capture.cubemap.getMemorySize();
+    return size;
+}
+
+void ReflectionCapturePool::use(Capture& capture, double screenSize, DynamicCubemap::MAPPING mapping, DynamicCubemap::FORMAT format, uint64_t frame) {
+    //The first model of a frame resets the requests, following ones can only raise the size and precision
+    if (capture.lastUsedFrame != frame) {
+        capture.screenSize = 0.0;
+        capture.requestedMapping = mapping;
+        capture.requestedFormat = format;
+    }
+    capture.screenSize = std::max(capture.screenSize, screenSize);
+    capture.requestedMapping = std::min(capture.requestedMapping, mapping);
+    capture.requestedFormat = std::max(capture.requestedFormat, format);
+    capture.lastUsedFrame = frame;
+}
+
+void ReflectionCapturePool::detach(Capture& capture, int modelId) {
+    capture.modelIds.erase(std::find(capture.modelIds.begin(), capture.modelIds.end(), modelId));
+    capture.dirtySides = Capture::ALL_SIDES;  //The model is now visible in the capture
+}
+
+bool ReflectionCapturePool::makeRoom(size_t size, uint64_t frame) {
+    const size_t budget = (size_t)(memoryBudget * 1024.0 * 1024.0);
+    size_t usedMemory = getUsedMemory();
+    while (usedMemory + size > budget) {
+        //Find the least recently used capture, captures in use this or the last frame are never evicted to avoid thrashing
+        auto lru = captures.end();
+        for (auto it = captures.begin(); it != captures.end(); it++)
+            if (it->lastUsedFrame + 1 < frame && (lru == captures.end() || it->lastUsedFrame < lru->lastUsedFrame))
+                lru = it;
+        if (lru == captures.end())
+            return false;
+
+        //Evict it
+        usedMemory -= lru->cubemap.getMemorySize();
+        destroyMap(*lru);
+        captures.erase(lru);
+        numEvictions++;
+    }
+    return true;
+}
+
+void ReflectionCapturePool::destroyMap(Capture& capture) {
+    //A running job renders into the map, so it has to finish first. Its result is dropped
+    if (capture.pendingJob != 0 && f_waitForJobs)
+        f_waitForJobs();
+    capture.pendingJob = 0;
+    capture.cubemap.destroy();
+}
+
+}  // namespace lenny
@@ -0,0 +1,93 @@
+#include <lenny/gui/ImGui.h>
+#include "ReflectionGovernor.h"
+
+#include <algorithm>
+
+namespace lenny {
+
+bool ReflectionGovernor::update(double frameTime, double targetFrameTime, double captureTime) {
+    //Enabling applies the current level, the settings may have been changed by hand meanwhile
+    if (!isEnabled) {
+        smoothedFrameTime = (smoothedFrameTime == 0.0) ? frameTime : 0.9 * smoothedFrameTime + 0.1 * frameTime;
+        wasEnabled = false;
+        return false;
+    }
+    if (!wasEnabled) {
+        wasEnabled = true;
+        startCooldown();
+        return true;
+    }
+
+    //The frames right after a change re-render the captures at the new level, they tell nothing about how the level performs
+    if (timeSinceChange < cooldown) {
+        timeSinceChange += frameTime;
+        return false;
+    }
+
+    //Smooth out single slow frames (e.g. a texture upload)
+    smoothedFrameTime = (smoothedFrameTime == 0.0) ? frameTime : 0.9 * smoothedFrameTime + 0.1 * frameTime;
+    timeSinceUpgrade += frameTime;
+
+    if (smoothedFrameTime > targetFrameTime * (1.0 + tolerance)) {
+        //Step down once the frame rate stayed below the target, the new level gets a fresh reaction time
+        timeAbove += frameTime;
+        timeBelow = 0.0;
+        if (timeAbove < reactionTime || level == 0)
+            return false;
+
+        //Probing failed, wait longer before trying this level again
+        if (timeSinceUpgrade < currentUpgradeDelay)
+            currentUpgradeDelay *= 2.0;
+        level--;
+        numDowngrades++;
+        startCooldown();
+        return true;
+    }
+
+    //An upgrade that held the target as long as the delay is settled
+    timeAbove = 0.0;
+    timeBelow += frameTime;
+    if (timeSinceUpgrade >= currentUpgradeDelay && timeBelow >= upgradeDelay)
+        currentUpgradeDelay = upgradeDelay;
+    if (timeBelow < currentUpgradeDelay || level + 1 >= (int)levels.size())
+        return false;
+
+    //Probe the next level only if its captures are expected to fit next to the rest of the frame (the scheduler never exceeds its budget)
+    const double estimatedTime = std::min(levels[level + 1].timeBudget, captureTime * levels[level + 1].timeBudget / levels[level].timeBudget);
+    if (estimatedTime > maxCaptureShare * targetFrameTime * 1000.0)
+        return false;
+    level++;
+    numUpgrades++;
+    timeSinceUpgrade = 0.0;
+    startCooldown();
+    return true;
+}
+
+void ReflectionGovernor::startCooldown() {
+    //Measure the new level from scratch once the cooldown is over
+    timeSinceChange = 0.0;
+    timeAbove = timeBelow = 0.0;
+    smoothedFrameTime = 0.0;
+}
+
+const ReflectionGovernor::Level& ReflectionGovernor::getLevel() const {
+    return levels[level];
+}
+
+void ReflectionGovernor::drawGui() {
+    if (ImGui::TreeNode("Quality governor")) {
+        ImGui::Checkbox("Hold the target frame rate", &isEnabled);
+        ImGui::Text("Frame rate: %.1f fps", smoothedFrameTime > 0.0 ? 1.0 / smoothedFrameTime : 0.0);
+        const Level& current = getLevel();
+        ImGui::Text("Level: %s", current.name);
+        ImGui::Text("Resolution scale: %.3f", current.resolutionScale);
+        ImGui::Text("Update budget: %.1f ms", current.timeBudget);
+        ImGui::Text("Proxy detail: %.2f", current.proxyThreshold);
+        ImGui::Text("Downgrades: %d, upgrades: %d", numDowngrades, numUpgrades);
+        ImGui::Text("Next probe after: %.1f s", currentUpgradeDelay);
+
+        ImGui::TreePop();
+    }
+}
+
+}  // namespace lenny
@@ -0,0 +1,156 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <lenny/gui/ImGui.h>
+#include "ReflectionProbeGrid.h"
+
+#include <algorithm>
+
+namespace lenny {
+
+void ReflectionProbeGrid::create() {
+    destroy();
+
+    //Place the probes on the grid between the minimum and maximum, a single probe along an axis sits in the middle
+    uint64_t id = 1;
+    for (int x = 0; x < numProbes.x; x++) {
+        for (int y = 0; y < numProbes.y; y++) {
+            for (int z = 0; z < numProbes.z; z++) {
+                const glm::ivec3 index(x, y, z);
+                glm::vec3 t(0.5f);
+                for (int k = 0; k < 3; k++)
+                    if (numProbes[k] > 1)
+                        t[k] = (float)index[k] / (float)(numProbes[k] - 1);
+
+                ReflectionCapturePool::Capture probe;
+                probe.id = id++;
+                probe.position = glm::mix(minimum, maximum, t);
+                probe.cubemap.width = probe.cubemap.height = resolution;
+                probe.cubemap.format = format;
+                probe.cubemap.create();
+                probes.emplace_back(probe);
+            }
+        }
+    }
+}
+
+void ReflectionProbeGrid::destroy() {
+    //Running jobs render into the probes, so they have to finish first
+    const bool hasPendingJobs =
+        std::any_of(probes.begin(), probes.end(), [](const ReflectionCapturePool::Capture& probe) -> bool { return probe.pendingJob != 0; });
+    if (hasPendingJobs && f_waitForJobs)
+        f_waitForJobs();
+    for (ReflectionCapturePool::Capture& probe : probes)
+        probe.cubemap.destroy();
+    probes.clear();
+}
+
+void ReflectionProbeGrid::use(uint64_t frame, const std::vector<Occluder>& models) {
+    //A probe inside a model would only see the model's inside, so the model is left out of its capture. Other models blending the probe still
+    //reflect each other. Every probe is in use, the scheduler bakes the dirty ones incrementally
+    for (ReflectionCapturePool::Capture& probe : probes) {
+        probe.lastUsedFrame = frame;
+        std::vector<int> modelIds;
+        for (const Occluder& model : models) {
+            const bool isInside = glm::distance(probe.position, model.center) < model.radius;
+            if (isInside)
+                modelIds.emplace_back(model.modelId);
+
+            //A model that appears in or disappears from the capture changes the sides that see it, like a moving model
+            if (isInside != probe.isUsedBy(model.modelId))
+                probe.dirtySides |= DynamicCubemap::getVisibleSides(probe.position, model.center, model.radius);
+        }
+        probe.modelIds = std::move(modelIds);
+    }
+}
+
+ReflectionProbeGrid::Blend ReflectionProbeGrid::getBlend(const glm::vec3& position) const {
+    //Find the nearest probes and the next one after them
+    std::vector<std::pair<float, const ReflectionCapturePool::Capture*>> candidates;
+    for (const ReflectionCapturePool::Capture& probe : probes)
+        candidates.emplace_back(glm::distance(probe.position, position), &probe);
+    const int numBlended = std::min((int)candidates.size(), MAX_BLENDED_PROBES);
+    const int numSorted = std::min((int)candidates.size(), MAX_BLENDED_PROBES + 1);
+    std::partial_sort(candidates.begin(), candidates.begin() + numSorted, candidates.end(),
+                      [](const auto& a, const auto& b) -> bool { return a.first < b.first; });
+
+    //Weight them by inverse squared distance less the weight of the next probe, so a probe fades out before it is replaced.
+    //A model at a probe only uses that probe
+    const auto getWeight = [](float distance) -> float { return 1.f / std::max(distance * distance, 1e-6f); };
+    const float cutoff = (numSorted > numBlended) ? getWeight(candidates[numBlended].first) : 0.f;
+    Blend blend;
+    float sum = 0.f;
+    for (int i = 0; i < numBlended; i++) {
+        blend.probes[i] = candidates[i].second;
+        blend.weights[i] = getWeight(candidates[i].first) - cutoff;
+        sum += blend.weights[i];
+    }
+
+    //All candidates at the same distance
+    if (sum <= 0.f) {
+        for (int i = 0; i < numBlended; i++)
+            blend.weights[i] = 1.f;
+        sum = (float)numBlended;
+    }
+    for (int i = 0; i < numBlended; i++)
+        blend.weights[i] /= sum;
+    blend.numProbes = numBlended;
+    return blend;
+}
+
+ReflectionProbeGrid::Blend ReflectionProbeGrid::Blend::getComplete() const {
+    Blend blend;
+    float sum = 0.f;
+    for (int i = 0; i < numProbes; i++) {
+        if (!probes[i]->isComplete)
+            continue;
+        blend.probes[blend.numProbes] = probes[i];
+        blend.weights[blend.numProbes] = weights[i];
+        sum += weights[i];
+        blend.numProbes++;
+    }
+    if (sum <= 0.f)
+        return Blend();
+    for (int i = 0; i < blend.numProbes; i++)
+        blend.weights[i] /= sum;
+    return blend;
+}
+
+size_t ReflectionProbeGrid::getUsedMemory() const {
+    size_t size = 0;
+    for (const ReflectionCapturePool::Capture& probe : probes)
+        size += probe.cubemap.getMemorySize();
+    return size;
+}
+
+size_t ReflectionProbeGrid::getUsedMemory(DynamicCubemap::FORMAT format) const {
+    size_t size = 0;
+    for (const ReflectionCapturePool::Capture& probe : probes)
+        if (probe.cubemap.format == format)
+            size += probe.cubemap.getMemorySize();
+    return size;
+}
+
+void ReflectionProbeGrid::drawGui() {
+    if (ImGui::TreeNode("Probe grid")) {
+        //Changes rebuild the grid once an edit is finished, the probes are then baked again over the next frames
+        ImGui::SliderInt3("Probes", &numProbes.x, 1, 8);
+        bool changed = ImGui::IsItemDeactivatedAfterEdit();
+        ImGui::InputFloat3("Minimum", &minimum.x);
+        changed |= ImGui::IsItemDeactivatedAfterEdit();
+        ImGui::InputFloat3("Maximum", &maximum.x);
+        changed |= ImGui::IsItemDeactivatedAfterEdit();
+        ImGui::SliderInt("Resolution", &resolution, 32, 512);
+        changed |= ImGui::IsItemDeactivatedAfterEdit();
+        int newFormat = format;
+        changed |= ImGui::Combo("Format", &newFormat, "RGB8\0R11G11B10F\0RGBA16F\0");
+        format = (DynamicCubemap::FORMAT)newFormat;
+        if (changed && !probes.empty())
+            create();
+
+        ImGui::Text("Probes: %d (%.1f MB)", (int)probes.size(), (double)getUsedMemory() / (1024.0 * 1024.0));
+
+        ImGui::TreePop();
+    }
+}
+
+}  // namespace lenny
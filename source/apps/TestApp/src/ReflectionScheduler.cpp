@@ -0,0 +1,172 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <lenny/gui/ImGui.h>
+#include "ReflectionScheduler.h"
+
+namespace lenny {
+
+ReflectionScheduler::~ReflectionScheduler() {
+    for (const Query& query : pendingQueries)
+        glDeleteQueries(1, &query.id);
+    if (!freeQueries.empty())
+        glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+}
+
+void ReflectionScheduler::update(std::list<ReflectionCapturePool::Capture>& captures, uint64_t frame, const F_renderCapture& f_renderCapture) {
+    //Update the cost estimates with the timings of previous frames
+    collectQueryResults();
+
+    //Update sides round-robin over the captures until the budget is used up
+    renderedSides = renderedCaptures = 0;
+    double estimatedTime = 0.0;
+    uint64_t lastRenderedCaptureId = 0;
+    pendingFrames.push_back({frame, 0, 0.0});
+    while (ReflectionCapturePool::Capture* capture = getNextCapture(captures, frame)) {
+        //A fully invalid capture is cheaper to render at once, unless that exceeds the remaining budget. It is then rendered one side per pass.
+        //Maps without sides can only be rendered as a whole
+        const bool isFullyDirty = capture->dirtySides == ReflectionCapturePool::Capture::ALL_SIDES;
+        const bool fitsBudget = !limitTime || estimatedTime + captureTime <= timeBudget;
+        const bool renderAllSides = capture->cubemap.mapping != DynamicCubemap::CUBE || (isFullyDirty && fitsBudget);
+        const double cost = renderAllSides ? captureTime : sideTime;
+
+        //Always render something, so reflections catch up eventually
+        if (limitTime && renderedSides > 0 && estimatedTime + cost > timeBudget)
+            break;
+
+        //Render while measuring the GPU time
+        const GLuint query = beginQuery();
+        int side = 0;
+        if (renderAllSides) {
+            f_renderCapture(*capture, ALL);
+            capture->dirtySides = 0;
+            renderedSides += 6;
+        } else {
+            while (!(capture->dirtySides & (1 << side)))
+                side++;
+            f_renderCapture(*capture, side);
+            capture->dirtySides &= ~(1 << side);
+            renderedSides++;
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        pendingQueries.push_back({query, frame, renderAllSides});
+        pendingFrames.back().numPendingQueries++;
+        if (capture->dirtySides == 0)
+            capture->isComplete = true;  //Maps start with all sides dirty, so every side was rendered at least once
+
+        //Continue with the next capture
+        estimatedTime += cost;
+        if (capture->id != lastRenderedCaptureId)
+            renderedCaptures++;
+        lastRenderedCaptureId = lastCaptureId = capture->id;
+    }
+
+    //Count what is left for the next frames
+    pendingSides = 0;
+    for (const ReflectionCapturePool::Capture& capture : captures)
+        for (int side = 0; side < 6; side++)
+            if (capture.dirtySides & (1 << side))
+                pendingSides++;
+}
+
+ReflectionCapturePool::Capture* ReflectionScheduler::takeNextCapture(std::list<ReflectionCapturePool::Capture>& captures, uint64_t frame) {
+    //Same round-robin order and budget as the captures rendered in update, always taking one per frame so reflections catch up eventually
+    if (takenFrame != frame) {
+        takenFrame = frame;
+        takenTime = 0.0;
+    }
+    if (limitTime && takenTime > 0.0 && takenTime + captureTime > timeBudget)
+        return nullptr;
+    ReflectionCapturePool::Capture* capture = getNextCapture(captures, frame);
+    if (capture) {
+        lastCaptureId = capture->id;
+        takenTime += captureTime;
+    }
+    return capture;
+}
+
+void ReflectionScheduler::measureCaptures(const std::vector<double>& captureTimes) {
+    //Captures rendered elsewhere always cover all sides. The frames without any are measured as 0, like those of update
+    collectQueryResults();
+    measuredFrameTime = 0.0;
+    for (const double time : captureTimes) {
+        captureTime = 0.9 * captureTime + 0.1 * time;
+        measuredFrameTime += time;
+    }
+}
+
+void ReflectionScheduler::drawGui() {
+    if (ImGui::TreeNode("Scheduler")) {
+        ImGui::Checkbox("Limit GPU time", &limitTime);
+        if (limitTime)
+            ImGui::SliderDouble("Budget (ms)", &timeBudget, 0.1, 16.0);
+        ImGui::Text("Rendered sides: %d", renderedSides);
+        ImGui::Text("Pending sides: %d", pendingSides);
+        ImGui::Text("Side: %.3f ms, capture: %.3f ms", sideTime, captureTime);
+        ImGui::Text("GPU time per frame: %.3f ms", measuredFrameTime);
+
+        ImGui::TreePop();
+    }
+}
+
+ReflectionCapturePool::Capture* ReflectionScheduler::getNextCapture(std::list<ReflectionCapturePool::Capture>& captures, uint64_t frame) const {
+    //Pick the dirty capture following the last one (by id), wrapping around at the end
+    ReflectionCapturePool::Capture *next = nullptr, *first = nullptr;
+    for (ReflectionCapturePool::Capture& capture : captures) {
+        if (capture.lastUsedFrame != frame || capture.dirtySides == 0 || capture.pendingJob != 0)
+            continue;
+        if (!first || capture.id < first->id)
+            first = &capture;
+        if (capture.id > lastCaptureId && (!next || capture.id < next->id))
+            next = &capture;
+    }
+    return next ? next : first;
+}
+
+GLuint ReflectionScheduler::beginQuery() {
+    GLuint query = 0;
+    if (freeQueries.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = freeQueries.back();
+        freeQueries.pop_back();
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    return query;
+}
+
+void ReflectionScheduler::collectQueryResults() {
+    //Results arrive in order, stop at the first one that is not available yet so we never stall
+    while (!pendingQueries.empty()) {
+        const Query query = pendingQueries.front();
+        GLint available = 0;
+        glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &elapsed);
+        pendingQueries.pop_front();
+        freeQueries.emplace_back(query.id);
+
+        //Update the running averages
+        const double time = (double)elapsed * 1e-6;
+        double& average = query.isCapture ? captureTime : sideTime;
+        average = 0.9 * average + 0.1 * time;
+
+        //Sum up the time per frame
+        for (FrameTime& frameTime : pendingFrames) {
+            if (frameTime.frame == query.frame) {
+                frameTime.time += time;
+                frameTime.numPendingQueries--;
+                break;
+            }
+        }
+    }
+
+    //Publish the frames that are complete, in order, including the ones that rendered nothing
+    while (!pendingFrames.empty() && pendingFrames.front().numPendingQueries == 0) {
+        measuredFrameTime = pendingFrames.front().time;
+        pendingFrames.pop_front();
+    }
+}
+
+}  // namespace lenny
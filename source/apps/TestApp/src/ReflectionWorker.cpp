@@ -0,0 +1,165 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <lenny/gui/Model.h>
+#include <lenny/gui/Shaders.h>
+#include <lenny/tools/Logger.h>
+#include "ReflectionWorker.h"
+
+namespace lenny {
+
+ReflectionWorker::~ReflectionWorker() {
+    //Programs are shared, so the main context deletes the ones of the worker
+    stop();
+    for (gui::Shader& shader : shaders)
+        shader.release();
+    if (window)
+        glfwDestroyWindow(window);
+}
+
+void ReflectionWorker::start() {
+    if (isRunning())
+        return;
+
+    //A hidden window with the same context settings, sharing the objects of the current context (kept on stop, the meshes' vertex arrays live in it)
+    if (!window) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(1, 1, "ReflectionWorker", nullptr, glfwGetCurrentContext());
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    }
+    if (!window) {
+        LENNY_LOG_WARNING("Could not create a shared context for the reflection worker")
+        return;
+    }
+
+    stopRequested = false;
+    thread = std::thread(&ReflectionWorker::run, this);
+}
+
+void ReflectionWorker::stop() {
+    if (!isRunning())
+        return;
+
+    //Unstarted jobs are dropped
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    jobAdded.notify_one();
+    thread.join();
+
+    //Sync objects are shared, so the main context can release the remaining ones
+    for (const Job& job : jobs)
+        glDeleteSync(job.ready);
+    for (const Result& result : results)
+        glDeleteSync(result.done);
+    jobs.clear();
+    results.clear();
+    numPending = 0;
+}
+
+bool ReflectionWorker::isRunning() const {
+    return thread.joinable();
+}
+
+void ReflectionWorker::submit(uint64_t jobId, const F_render& f_render) {
+    //Everything the main context issued so far (uploads, new textures) has to be done before the worker reads it
+    GLsync ready = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({jobId, ready, f_render});
+        numPending++;
+    }
+    jobAdded.notify_one();
+}
+
+std::vector<ReflectionWorker::Finished> ReflectionWorker::collectFinished() {
+    //Results arrive in order, stop at the first one the GPU has not finished yet
+    std::vector<Finished> finished;
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!results.empty()) {
+        const GLenum status = glClientWaitSync(results.front().done, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            break;
+        glDeleteSync(results.front().done);
+        finished.push_back({results.front().id, results.front().gpuTime});
+        results.pop_front();
+        numPending--;
+    }
+    return finished;
+}
+
+void ReflectionWorker::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobFinished.wait(lock, [&]() -> bool { return (jobs.empty() && !isBusy) || !isRunning(); });
+}
+
+int ReflectionWorker::getNumPending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numPending;
+}
+
+void ReflectionWorker::run() {
+    glfwMakeContextCurrent(window);
+
+    //Context state is not shared, enable what the main context uses
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    //Programs (compiled on the first run), vertex arrays and framebuffers of this context
+    if (shaders.empty())
+        gui::Shaders::initialize();
+    else
+        gui::Shaders::attach(std::move(shaders));
+    gui::Model::Mesh::isSharedContext = true;
+    GLuint framebuffer = 0, query = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glGenQueries(1, &query);
+
+    while (true) {
+        //Wait for the next job
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock, [&]() -> bool { return stopRequested || !jobs.empty(); });
+            if (stopRequested)
+                break;
+            job = jobs.front();
+            jobs.pop_front();
+            isBusy = true;
+        }
+
+        //Render after the main context's commands, then hand the result back with a fence
+        gui::Model::Mesh::deleteSharedContextArrays();
+        gui::Shaders::compileNextVariant();
+        glWaitSync(job.ready, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(job.ready);
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        job.f_render(framebuffer);
+        glEndQuery(GL_TIME_ELAPSED);
+        GLsync done = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        //Queries are not shared, so the worker waits for the job's GPU time itself. Only this thread waits, the jobs just don't overlap on the GPU
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            results.push_back({job.id, done, (double)elapsed * 1e-6});
+            isBusy = false;
+        }
+        jobFinished.notify_all();
+    }
+
+    gui::Model::Mesh::deleteSharedContextArrays();
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteQueries(1, &query);
+    shaders = gui::Shaders::detach();
+    glfwMakeContextCurrent(nullptr);
+    jobFinished.notify_all();
+}
+
+}  // namespace lenny
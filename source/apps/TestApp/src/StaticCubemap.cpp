@@ -1,52 +1,183 @@
-
 #include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <lenny/gui/Renderer.h>
 #include <lenny/gui/Shaders.h>
+#include <lenny/gui/TextureUploader.h>
+#include <lenny/tools/Utils.h>
 #include <stb_image.h>
 #include "StaticCubemap.h"
 
-namespace lenny {
+#include <array>
+#include <filesystem>
 
-void StaticCubemap::load(std::vector<std::string>& filenames) {
-    //Create a new cubemap texture
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+namespace lenny {
 
-    //Cubemap textures should not be upside-down
-    stbi_set_flip_vertically_on_load(0);
+tools::Cubemap StaticCubemap::loadFaces(const std::vector<std::string>& filenames) {
+    //Read and decode the faces in parallel (stb does not flip them by default, as cubemap faces need)
+    struct Image {
+        unsigned char *data = nullptr;
+        int width = 0, height = 0, nrComponents = 0;
+    };
+    std::array<Image, 6> images;
+    tools::utils::parallelFor(6, 6, [&](int side) -> void {
+        Image &image = images[side];
+        image.data = stbi_load(filenames[side].c_str(), &image.width, &image.height, &image.nrComponents, 0);
+    });
 
+    //Set the faces, they need to be square and of equal size
+    tools::Cubemap cubemap;
     for (int side = 0; side < 6; side++) {
-        //Load the image
-        int width, height, nrComponents;
-        unsigned char *data = stbi_load(filenames[side].c_str(), &width, &height, &nrComponents, 0);
-        if (data) {
-            GLenum format = 0;
-            if (nrComponents == 1)
-                format = GL_RED;
-            else if (nrComponents == 3)
-                format = GL_RGB;
-            else if (nrComponents == 4)
-                format = GL_RGBA;
-
-            //Create one side of cubemap texture from image
-            GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + side;
-            glTexImage2D(target, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        const Image &image = images[side];
+        if (image.data) {
+            if (side == 0)
+                cubemap = tools::Cubemap(image.width);
+            if (image.width != image.height || image.width != cubemap.getSize())
+                LENNY_LOG_WARNING("Side `%s` is not square or of a different size than the first side", filenames[side].c_str())
+            else
+                cubemap.setFace(side, image.data, image.nrComponents);
 
-            stbi_image_free(data);
+            stbi_image_free(image.data);
         } else {
             LENNY_LOG_WARNING("Failed to load texture from path `%s`", filenames[side].c_str());
         }
+    }
+    if (cubemap.getNumLevels() == 0)
+        cubemap = tools::Cubemap(1);
+    return cubemap;
+}
 
-        //Set texture parameters
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+tools::Cubemap StaticCubemap::loadEquirectangular(const std::string& filename, int faceSize) {
+    //Radiance files are decoded to floats, 8-bit images keep their values like the six faces (stb would linearize them with its global gamma)
+    int width, height, nrComponents;
+    std::vector<float> pixels;
+    if (stbi_is_hdr(filename.c_str())) {
+        float *data = stbi_loadf(filename.c_str(), &width, &height, &nrComponents, 0);
+        if (data) {
+            pixels.assign(data, data + (size_t)width * height * nrComponents);
+            stbi_image_free(data);
+        }
+    } else {
+        unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+        if (data) {
+            pixels.resize((size_t)width * height * nrComponents);
+            for (size_t i = 0; i < pixels.size(); i++)
+                pixels[i] = (float)data[i] / 255.f;
+            stbi_image_free(data);
+        }
     }
+    if (pixels.empty()) {
+        LENNY_LOG_WARNING("Failed to load texture from path `%s`", filename.c_str());
+        return tools::Cubemap(1);
+    }
+
+    //A face covers a quarter of the longitude range
+    LENNY_LOG_INFO("Converting the equirectangular environment map...")
+    if (faceSize <= 0)
+        faceSize = std::max(1, width / 4);
+    return tools::Cubemap::fromEquirectangular(pixels.data(), width, height, nrComponents, faceSize);
+}
+
+bool StaticCubemap::isEquirectangular(const std::string& filename) {
+    //Radiance files, or images spanning twice as much longitude as latitude
+    if (stbi_is_hdr(filename.c_str()))
+        return true;
+    int width, height, nrComponents;
+    return stbi_info(filename.c_str(), &width, &height, &nrComponents) && width == 2 * height;
+}
+
+std::vector<std::string> StaticCubemap::getFaceFilenames(const std::string& folder) {
+    //Use ordering of cube sides according to cubemap constants in glad.h
+    return {
+        folder + "/right.png",   //GL_TEXTURE_CUBE_MAP_POSITIVE_X
+        folder + "/left.png",    //GL_TEXTURE_CUBE_MAP_NEGATIVE_X
+        folder + "/top.png",     //GL_TEXTURE_CUBE_MAP_POSITIVE_Y
+        folder + "/bottom.png",  //GL_TEXTURE_CUBE_MAP_NEGATIVE_Y
+        folder + "/front.png",   //GL_TEXTURE_CUBE_MAP_POSITIVE_Z
+        folder + "/back.png"     //GL_TEXTURE_CUBE_MAP_NEGATIVE_Z
+    };
+}
 
+uint64_t StaticCubemap::getSourceKey(const std::vector<std::string>& filenames) {
+    //Missing files contribute their path only, so adding them later changes the key
+    uint64_t key = tools::utils::hash(nullptr, 0);
+    for (const std::string& filename : filenames) {
+        std::error_code error;
+        const uint64_t fileSize = std::filesystem::file_size(filename, error);
+        const int64_t writeTime = std::filesystem::last_write_time(filename, error).time_since_epoch().count();
+        key = tools::utils::hash(filename.data(), filename.size(), key);
+        if (!error) {
+            key = tools::utils::hash(&fileSize, sizeof(fileSize), key);
+            key = tools::utils::hash(&writeTime, sizeof(writeTime), key);
+        }
+    }
+    return key;
+}
+
+uint64_t StaticCubemap::getKey(uint64_t sourceKey) const {
+    //The prefilter settings are chained onto the key of the sources
+    uint64_t key = tools::utils::hash(&numLevels, sizeof(numLevels), sourceKey);
+    return tools::utils::hash(&numSamples, sizeof(numSamples), key);
+}
+
+bool StaticCubemap::convert(const tools::Cubemap& faces, const std::string& containerPath, uint64_t sourceKey) const {
+    //Prefilter the mip chain and project the irradiance once, loading then only maps the result
+    LENNY_LOG_INFO("Prefiltering the environment map...")
+    const tools::Cubemap prefiltered = faces.prefilterGGX(numLevels, numSamples);
+    return tools::CubemapContainer::write(containerPath, getKey(sourceKey), prefiltered, tools::SphericalHarmonics::project(faces));
+}
+
+bool StaticCubemap::load(const std::string& containerPath, uint64_t sourceKey) {
+    tools::CubemapContainer container;
+    if (!container.open(containerPath, getKey(sourceKey)))
+        return false;
+    destroy();
+    numLevels = container.getNumLevels();
+    irradiance = container.getIrradiance();
+
+    //Create a new immutable cubemap texture and stream all levels straight from the mapped file through the pixel buffers
+    texture = gui::TextureUploader::createTexture(GL_TEXTURE_CUBE_MAP, GL_RGBA16F, container.getSize(0), container.getSize(0), numLevels);
+    for (int level = 0; level < numLevels; level++) {
+        const int size = container.getSize(level);
+        for (int side = 0; side < 6; side++)
+            gui::TextureUploader::upload(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, level, size, size, GL_RGBA, GL_HALF_FLOAT, container.getFace(level, side),
+                                         (size_t)size * size * 4 * sizeof(uint16_t));
+    }
+
+    //Set texture parameters
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+
+    //Filter across the sides, the small levels would show seams otherwise
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    return true;
+}
+
+void StaticCubemap::destroy() {
+    glDeleteTextures(1, &texture);
+    texture = 0;
+}
+
+bool StaticCubemap::readback(tools::Cubemap& cubemap) const {
+    if (texture == 0)
+        return false;
+
+    //The texels of tools::Cubemap are tightly packed float RGBA
+    GLint size = 0;
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &size);
+    cubemap = tools::Cubemap(size, numLevels);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (int level = 0; level < numLevels; level++)
+        for (int side = 0; side < 6; side++)
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, level, GL_RGBA, GL_FLOAT, cubemap.getFace(level, side));
     glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    return size > 0;
 }
 
-}  // namespace lenny
\ No newline at end of file
+}  // namespace lenny
@@ -1,55 +1,21 @@
 #include "TestApp.h"
 
 #include <glad/glad.h>
+#include <lenny/gui/AssetRegistry.h>
 #include <lenny/gui/Guizmo.h>
 #include <lenny/gui/ImGui.h>
 #include <lenny/gui/Renderer.h>
 #include <lenny/gui/Shaders.h>
-#include <stb_image.h>
+#include <lenny/tools/SoftwareRasterizer.h>
+#include <stb_image_write.h>
 
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
 #include <glm/gtc/matrix_transform.hpp>
 
 namespace lenny {
 
-uint loadTexture(const std::string& filePath) {
-    //Create a new 2D texture
-    uint textureID;
-    glGenTextures(1, &textureID);
-
-    //2D textures should be upside-down
-    stbi_set_flip_vertically_on_load(1);
-
-    //Load the image
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filePath.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format = 0;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        //Create 2D texture from image
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        //Set texture parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    } else {
-        LENNY_LOG_WARNING("Failed to load texture from path `%s`", filePath.c_str());
-    }
-    stbi_image_free(data);
-
-    glBindTexture(GL_TEXTURE_2D, 0);
-    return textureID;
-}
-
 TestApp::TestApp() : gui::Application("TestApp") {
     //Setup scene
     const auto [width, height] = getCurrentWindowSize();
@@ -60,130 +26,727 @@ TestApp::TestApp() : gui::Application("TestApp") {
     };
     scenes.back()->f_fileDropCallback = [&](int count, const char** fileNames) -> void { fileDropCallback(count, fileNames); };
 
-    //Skybox textures
-    std::vector<std::string> filenames = {
-        //Use ordering of cube sides according to cubemap constants in glad.h
-        LENNY_GUI_TESTAPP_FOLDER "/config/envmap/right.png",   //GL_TEXTURE_CUBE_MAP_POSITIVE_X
-        LENNY_GUI_TESTAPP_FOLDER "/config/envmap/left.png",    //GL_TEXTURE_CUBE_MAP_NEGATIVE_X
-        LENNY_GUI_TESTAPP_FOLDER "/config/envmap/top.png",     //GL_TEXTURE_CUBE_MAP_POSITIVE_Y
-        LENNY_GUI_TESTAPP_FOLDER "/config/envmap/bottom.png",  //GL_TEXTURE_CUBE_MAP_NEGATIVE_Y
-        LENNY_GUI_TESTAPP_FOLDER "/config/envmap/front.png",   //GL_TEXTURE_CUBE_MAP_POSITIVE_Z
-        LENNY_GUI_TESTAPP_FOLDER "/config/envmap/back.png"     //GL_TEXTURE_CUBE_MAP_NEGATIVE_Z
-    };
+    //Maps are only destroyed once the worker no longer renders into them
+    capturePool.f_waitForJobs = [&]() -> void { worker.waitUntilIdle(); };
+    probeGrid.f_waitForJobs = [&]() -> void { worker.waitUntilIdle(); };
+
+    //Load the default models in parallel
+    loadDefaultModels();
 
-    //Create the skybox model and cubemaps
-    loadSkybox(filenames);
-    staticCubemap.load(filenames);
-    dynamicCubemap.create();
+    //Create the skybox model and cubemap from the six faces
+    loadSkybox();
+    loadEnvironment("");
 }
 
-void TestApp::loadSkybox(std::vector<std::string>& filenames) {
-    //Vertices for a square side of the skybox, each containing position, normal, texCoords
-    std::vector<gui::Model::Mesh::Vertex> vertices = {
-        {glm::vec3(-1, -1, 1), glm::vec3(0, 0, -1), glm::vec2(0, 0)},
-        {glm::vec3(+1, -1, 1), glm::vec3(0, 0, -1), glm::vec2(1, 0)},
-        {glm::vec3(+1, +1, 1), glm::vec3(0, 0, -1), glm::vec2(1, 1)},
-        {glm::vec3(-1, +1, 1), glm::vec3(0, 0, -1), glm::vec2(0, 1)},
+void TestApp::loadDefaultModels() {
+    struct Placement {
+        std::string filePath;
+        Eigen::Vector3d position;
+        Eigen::QuaternionD orientation;
+        double scale;
     };
+    const std::vector<Placement> placements = {
+        {LENNY_GUI_TESTAPP_FOLDER "/config/yumi/Base.obj", Eigen::Vector3d(-1.0, 0.5, 0.0),
+         Eigen::QuaternionD(tools::utils::rotY(-PI / 2.0) * tools::utils::rotX(-PI / 2.0)), 1.0},
+        {LENNY_GUI_TESTAPP_FOLDER "/config/gripper/Gripper.obj", Eigen::Vector3d(-0.5, 0.5, 0.0), Eigen::QuaternionD::Identity(), 3.0},
+        {LENNY_GUI_TESTAPP_FOLDER "/config/nao/12211_Robot_l2.obj", Eigen::Vector3d(0.0, 0.5, 0.0), Eigen::QuaternionD(tools::utils::rotX(-PI / 2.0)), 0.03},
+        {LENNY_GUI_TESTAPP_FOLDER "/config/widowx/Base.stl", Eigen::Vector3d(0.5, 0.5, 0.0), Eigen::QuaternionD(tools::utils::rotX(-PI / 2.0)), 0.003},
+        {LENNY_GUI_TESTAPP_FOLDER "/config/spot/Body.dae", Eigen::Vector3d(1.0, 0.5, 0.0), Eigen::QuaternionD::Identity(), 1.0},
+        {LENNY_GUI_OPENGL_FOLDER "/data/meshes/sphere.obj", Eigen::Vector3d(-2, 1, 1), Eigen::QuaternionD::Identity(), 2.0}};
+
+    //Request all files first, then upload them in order (keeping the ids stable) while the later ones are still loading
+    std::vector<uint64_t> tickets;
+    for (const Placement& placement : placements)
+        tickets.push_back(modelLoader.request(placement.filePath));
+    models.reserve(placements.size());
+    for (size_t i = 0; i < placements.size(); i++) {
+        //Without a result (taken elsewhere), the model loads the file itself
+        std::optional<gui::ModelLoader::Result> result = modelLoader.wait(tickets[i]);
+        if (result)
+            models.emplace_back(placements[i].filePath, std::move(result->data), placements[i].position, placements[i].orientation, placements[i].scale);
+        else
+            models.emplace_back(placements[i].filePath, placements[i].position, placements[i].orientation, placements[i].scale);
+    }
+}
+
+bool TestApp::AppModel::updateChangeState() {
+    //Small tolerances absorb the float round trip of the guizmo widget
+    const bool changed = !isTracked || (position - trackedPosition).norm() > 1e-6 || orientation.angularDistance(trackedOrientation) > 1e-6 ||
+                         (scale - trackedScale).norm() > 1e-6;
+    if (changed) {
+        isTracked = true;
+        trackedPosition = position;
+        trackedOrientation = orientation;
+        trackedScale = scale;
+    }
+    return changed;
+}
 
-    //Indices for 2 triangles per skybox side
-    std::vector<uint> indices = {0, 1, 2, 0, 2, 3};
+void TestApp::loadEnvironment(const std::string& equirectangularPath) {
+    //The six faces of the config folder, or a single equirectangular image. Containers are generated, so they go into the ignored cache folder
+    const std::vector<std::string> sources = equirectangularPath.empty() ? StaticCubemap::getFaceFilenames(LENNY_GUI_TESTAPP_FOLDER "/config/envmap")
+                                                                         : std::vector<std::string>{equirectangularPath};
+    const std::string containerName = equirectangularPath.empty() ? "envmap" : std::filesystem::path(equirectangularPath).stem().string();
+    const std::string containerPath = LENNY_PROJECT_FOLDER "/cache/environments/" + containerName + ".lenv";
 
-    //Create 6 skybox meshes for each side of the skybox
-    for (std::string& filename : filenames) {
-        //Create a material by loading the corresponding texture
-        gui::Model::Mesh::Material material;
-        material.texture_diffuse = loadTexture(filename);
+    //Captures in flight sample the current environment
+    worker.waitUntilIdle();
 
-        //Append a new mesh to the skybox
-        skybox.emplace_back(vertices, indices, material);
+    //Map the precompiled container, the sources are only decoded to (re)build it when they or the prefilter settings changed
+    const uint64_t sourceKey = StaticCubemap::getSourceKey(sources);
+    if (!staticCubemap.load(containerPath, sourceKey)) {
+        const tools::Cubemap faces = equirectangularPath.empty() ? StaticCubemap::loadFaces(sources) : StaticCubemap::loadEquirectangular(equirectangularPath);
+        if (!staticCubemap.convert(faces, containerPath, sourceKey) || !staticCubemap.load(containerPath, sourceKey)) {
+            LENNY_LOG_WARNING("Could not create the environment container `%s`, keeping the current environment", containerPath.c_str())
+            return;
+        }
     }
+
+    //Every capture shows the environment
+    lastCaptureSettings = std::nullopt;
 }
 
-void TestApp::drawSkybox() const {
-    //Skybox size
-    glm::mat4 scale = glm::scale(glm::mat4(1), glm::vec3(50));
+void TestApp::loadSkybox() {
+    //A cube around the view point, the skybox shader samples the static cubemap in the direction of each fragment.
+    //Its sides are subdivided, so the per-vertex projections of the paraboloid and octahedral captures cover their maps
+    const int numSegments = 8;
+    std::vector<gui::Model::Mesh::Vertex> vertices;
+    std::vector<uint> indices;
+    for (int side = 0; side < 6; side++) {
+        const uint firstVertex = (uint)vertices.size();
+        for (int y = 0; y <= numSegments; y++)
+            for (int x = 0; x <= numSegments; x++) {
+                const Eigen::Vector3f direction = tools::Cubemap::getDirection(side, (float)x / numSegments, (float)y / numSegments);
+                vertices.push_back({glm::vec3(direction.x(), direction.y(), direction.z()), glm::vec3(0), glm::vec2(0)});
+            }
+        for (int y = 0; y < numSegments; y++)
+            for (int x = 0; x < numSegments; x++) {
+                const uint i = firstVertex + y * (numSegments + 1) + x;
+                indices.insert(indices.end(), {i, i + 1, i + numSegments + 2, i, i + numSegments + 2, i + numSegments + 1});
+            }
+    }
+    skybox.emplace(vertices, indices);
+}
 
+void TestApp::drawSkybox(const glm::vec3& viewPoint) const {
+    //Centered at the view point, the shaders move it to maximum depth so it only fills pixels nothing else covered
     gui::Shaders::activeShader->setBool("isSkybox", true);
     gui::Shaders::activeShader->setFloat("objectAlpha", 1.0f);
+    gui::Shaders::activeShader->setMat4("modelPose", glm::translate(glm::mat4(1), viewPoint));
+    glDepthFunc(GL_LEQUAL);
+    skybox->draw(std::nullopt);
+    glDepthFunc(GL_LESS);
+    gui::Shaders::activeShader->setBool("isSkybox", false);
+}
 
-    //Draw right side
-    glm::mat4 transform = glm::rotate(scale, glm::radians(90.0f), glm::vec3(0, 1, 0));
-    gui::Shaders::activeShader->setMat4("modelPose", transform);
-    skybox[0].draw(std::nullopt);
+void TestApp::updateReflectionCapture(ReflectionCapturePool::Capture& capture, int side) {
+    CapturePass pass = getCapturePass(capture, side);
+    renderCapturePass(pass);
+}
+
+void TestApp::submitReflectionCapture(ReflectionCapturePool::Capture& capture) {
+    //The worker renders all sides into the back texture, which is swapped in once its fence is signaled
+    if (capture.cubemap.backTexture == 0)
+        capture.cubemap.createBackTexture();
+    CapturePass pass = getCapturePass(capture, ReflectionScheduler::ALL);
+    pass.cubemap.texture = capture.cubemap.backTexture;
+    pass.useLayeredRendering = true;
 
-    //Draw left side
-    transform = glm::rotate(scale, glm::radians(-90.0f), glm::vec3(0, 1, 0));
-    gui::Shaders::activeShader->setMat4("modelPose", transform);
-    skybox[1].draw(std::nullopt);
+    //Changes from now on are rendered by a later job
+    capture.dirtySides = 0;
+    capture.pendingJob = nextJobId++;
+    worker.submit(capture.pendingJob, [this, pass](GLuint framebuffer) mutable -> void {
+        //Framebuffers are not shared, so the worker attaches the textures to its own one
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, pass.cubemap.texture, 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, pass.cubemap.depthTexture, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        pass.cubemap.framebuffer = 0;
+        pass.cubemap.layeredFramebuffer = framebuffer;
+        renderCapturePass(pass);
+    });
+}
 
-    //Draw top side
-    transform = glm::rotate(scale, glm::radians(-90.0f), glm::vec3(1, 0, 0));
-    gui::Shaders::activeShader->setMat4("modelPose", transform);
-    skybox[2].draw(std::nullopt);
+void TestApp::updateCapturesOnWorker() {
+    //Without a shared context the captures are rendered on the main thread again
+    if (!worker.isRunning())
+        worker.start();
+    if (!worker.isRunning()) {
+        useWorkerThread = false;
+        return;
+    }
 
-    //Draw bottom side
-    transform = glm::rotate(scale, glm::radians(90.0f), glm::vec3(1, 0, 0));
-    gui::Shaders::activeShader->setMat4("modelPose", transform);
-    skybox[3].draw(std::nullopt);
+    //Swap in the finished captures of both sets (switching between them leaves jobs of the other one), results for released captures are dropped
+    executedCaptures = 0;
+    std::vector<double> captureTimes;
+    for (const ReflectionWorker::Finished& finished : worker.collectFinished()) {
+        captureTimes.emplace_back(finished.gpuTime);
+        for (std::list<ReflectionCapturePool::Capture>* captures : {&capturePool.captures, &probeGrid.probes}) {
+            for (ReflectionCapturePool::Capture& capture : *captures) {
+                if (capture.pendingJob == finished.id) {
+                    capture.cubemap.swapBackTexture();
+                    capture.pendingJob = 0;
+                    capture.isComplete = true;  //Jobs render all sides
+                    executedCaptures++;
+                }
+            }
+        }
+    }
 
-    //Draw front side
-    transform = scale;
-    gui::Shaders::activeShader->setMat4("modelPose", transform);
-    skybox[4].draw(std::nullopt);
+    scheduler.measureCaptures(captureTimes);
 
-    //Draw back side
-    transform = glm::rotate(scale, glm::radians(180.0f), glm::vec3(0, 1, 0));
-    gui::Shaders::activeShader->setMat4("modelPose", transform);
-    skybox[5].draw(std::nullopt);
+    //Keep a few captures in flight within the scheduler's budget, the main thread only records what they draw
+    while (worker.getNumPending() < maxPendingJobs) {
+        ReflectionCapturePool::Capture* capture = scheduler.takeNextCapture(getActiveCaptures(), frame);
+        if (!capture)
+            break;
+        submitReflectionCapture(*capture);
+    }
+}
 
-    gui::Shaders::activeShader->setBool("isSkybox", false);
+void TestApp::stopWorker() {
+    //Captures that were in flight are rendered again on the main thread
+    worker.stop();
+    for (std::list<ReflectionCapturePool::Capture>* captures : {&capturePool.captures, &probeGrid.probes}) {
+        for (ReflectionCapturePool::Capture& capture : *captures) {
+            if (capture.pendingJob != 0) {
+                capture.pendingJob = 0;
+                capture.dirtySides = ReflectionCapturePool::Capture::ALL_SIDES;
+            }
+        }
+    }
 }
 
-void TestApp::updateDynamicCubemap(int modelIndex) {
-    //Bind the cubemap framebuffer
-    dynamicCubemap.startUpdating();
+TestApp::CapturePass TestApp::getCapturePass(const ReflectionCapturePool::Capture& capture, int side) const {
+    CapturePass pass;
+    pass.cubemap = capture.cubemap;
+    pass.position = capture.position;
+    pass.side = side;
+    pass.useLayeredRendering = useLayeredRendering;
 
-    //Use the model's position as a view point
-    glm::vec3 position = gui::utils::toGLM(models[modelIndex].position);
-    gui::Shaders::activeShader->setVec3("cameraPosition", position);
+    //Shading
+    pass.light = scenes.back()->light;
+    pass.enableEnvironmentMapping = enableEnvironmentMapping;
+    pass.environmentMappingType = environmentMappingType;
+    pass.environmentLod = getEnvironmentLod();
+    pass.environmentTexture = staticCubemap.texture;
+    pass.useIrradiance = enableEnvironmentMapping && useIrradiance;
+    pass.irradiance = staticCubemap.irradiance;
+    if (!showMaterials)
+        pass.modelColor = rendererColor.segment(0, 3);
+    pass.alpha = rendererColor[3];
+    pass.useProxyMeshes = useProxyMeshes;
 
-    //Use the 90-degree field of view
-    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 1000.0f);
-    gui::Shaders::activeShader->setMat4("cameraProjection", projection);
+    //Models inside the frustums of the rendered sides
+    const uint8_t sides = (side == ReflectionScheduler::ALL) ? ReflectionCapturePool::Capture::ALL_SIDES : (uint8_t)(1 << side);
+    for (int i = 0; i < (int)models.size(); i++) {
+        //Skip the models using this capture to avoid problems with self-reflections
+        if (capture.isUsedBy(models[i].id))
+            continue;
 
-    //Render to each side of the cubemap
-    for (int side = 0; side < 6; side++) {
-        //Select the cubemap side
-        glm::mat4 view = dynamicCubemap.selectSide(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, position);
-        gui::Shaders::activeShader->setMat4("cameraView", view);
+        //Don't draw the reference sphere if unchecked
+        if (!showReferenceSphere && models[i].mesh.filePath.ends_with("sphere.obj"))
+            continue;
 
-        //Draw the skybox
-        drawSkybox();
+        //Skip the models outside the frustums of the rendered sides
+        const gui::Model::BoundingSphere bounds = models[i].mesh.getBoundingSphere(models[i].position, models[i].orientation, models[i].scale);
+        const uint8_t visibleSides = DynamicCubemap::getVisibleSides(capture.position, bounds.center, bounds.radius) & sides;
+        if (visibleSides == 0)
+            continue;
 
-        //Draw the models
-        std::optional<Eigen::Vector3d> modelColor = std::nullopt;
-        if (!showMaterials)
-            modelColor = rendererColor.segment(0, 3);
-        for (int i = 0; i < (int)models.size(); i++) {
-            //Skip itself to avoid problems with self-reflections
-            if (i == modelIndex)
-                continue;
+        pass.items.push_back({&models[i].mesh, models[i].position, models[i].orientation, models[i].scale, visibleSides});
+    }
+    return pass;
+}
+
+void TestApp::renderCapturePass(CapturePass& pass) const {
+    DynamicCubemap& dynamicCubemap = pass.cubemap;
+
+    //Reflections inside the capture use the static cubemap, so no capture samples a texture that is being rendered
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, pass.environmentTexture);
 
-            //Don't draw the reference sphere if unchecked
-            if (!showReferenceSphere && models[i].mesh.filePath.ends_with("sphere.obj"))
+    //Use the capture's position as a view point and the 90-degree field of view
+    const glm::vec3 position = pass.position;
+    const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 1000.0f);
+
+    //Everything else the capture shaders read, the worker's shaders have no other source
+    const auto setUniforms = [&]() -> void {
+        gui::Shaders::activeShader->activate();
+        gui::Shaders::activeShader->setBool("enableEnvironmentMapping", pass.enableEnvironmentMapping);
+        gui::Shaders::activeShader->setInt("environmentMappingType", pass.environmentMappingType);
+        gui::Shaders::activeShader->setFloat("environmentLod", pass.environmentLod);
+        gui::Shaders::activeShader->setInt("environmentParameterization", 0);
+        gui::Shaders::activeShader->setInt("numProbes", 0);
+        setIrradiance(pass.irradiance, pass.useIrradiance);
+        gui::Shaders::activeShader->setVec3("cameraPosition", position);
+    };
+    gui::Shaders::updateLight(pass.light);
+
+    if (dynamicCubemap.mapping != DynamicCubemap::CUBE) {
+        //Switch to the shader that projects each triangle onto the paraboloids or octants (these maps have no separate sides)
+        gui::Shaders::setActiveShader(dynamicCubemap.mapping == DynamicCubemap::DUAL_PARABOLOID ? gui::Shaders::PARABOLOID : gui::Shaders::OCTAHEDRAL);
+        setUniforms();
+        gui::Shaders::activeShader->setVec3("captureOrigin", position);
+        gui::Shaders::activeShader->setFloat("captureNear", 0.1f);
+        gui::Shaders::activeShader->setFloat("captureFar", 1000.0f);
+
+        //The octahedral shader clips the triangles at the octant borders, the paraboloid shader clips them at the hemisphere itself
+        const int numClipDistances = (dynamicCubemap.mapping == DynamicCubemap::DUAL_PARABOLOID) ? 0 : 3;
+        for (int i = 0; i < numClipDistances; i++)
+            glEnable(GL_CLIP_DISTANCE0 + i);
+
+        //Render the whole map in a single pass
+        dynamicCubemap.startUpdatingAllSides();
+        drawReflectedScene(pass, ReflectionCapturePool::Capture::ALL_SIDES);
+        dynamicCubemap.stopUpdating();
+
+        for (int i = 0; i < numClipDistances; i++)
+            glDisable(GL_CLIP_DISTANCE0 + i);
+    } else if (pass.side == ReflectionScheduler::ALL && pass.useLayeredRendering) {
+        //Switch to the shader that routes each triangle to all cubemap sides
+        gui::Shaders::setActiveShader(gui::Shaders::CUBEMAP);
+        setUniforms();
+        gui::Shaders::activeShader->setMat4("cameraProjection", projection);
+        for (int i = 0; i < 6; i++)
+            gui::Shaders::activeShader->setMat4("cameraViews[" + std::to_string(i) + "]",
+                                                DynamicCubemap::getSideView(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, position));
+
+        //Render all sides of the cubemap in a single pass
+        dynamicCubemap.startUpdatingAllSides();
+        drawReflectedScene(pass, ReflectionCapturePool::Capture::ALL_SIDES);
+        dynamicCubemap.stopUpdating();
+    } else {
+        //Bind the cubemap framebuffer
+        gui::Shaders::setActiveShader(gui::Shaders::BASIC);
+        setUniforms();
+        dynamicCubemap.startUpdating();
+        gui::Shaders::activeShader->setMat4("cameraProjection", projection);
+
+        //Render to the requested side or to each side of the cubemap
+        for (int i = 0; i < 6; i++) {
+            if (pass.side != ReflectionScheduler::ALL && pass.side != i)
                 continue;
 
-            //Draw the model
-            models[i].mesh.draw(models[i].position, models[i].orientation, models[i].scale, modelColor, rendererColor[3]);
+            //Select the cubemap side
+            glm::mat4 view = dynamicCubemap.selectSide(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, position);
+            gui::Shaders::activeShader->setMat4("cameraView", view);
+
+            drawReflectedScene(pass, 1 << i);
         }
+
+        //Unbind the cubemap framebuffer
+        dynamicCubemap.stopUpdating();
     }
+    gui::Shaders::setActiveShader(gui::Shaders::BASIC);
+}
 
-    //Unbind the cubemap framebuffer
-    dynamicCubemap.stopUpdating();
+void TestApp::drawReflectedScene(const CapturePass& pass, uint8_t sides) const {
+    //A layered pass renders all sides at once, the geometry shader then skips the sides where a model is culled
+    const bool isLayered = (sides == ReflectionCapturePool::Capture::ALL_SIDES);
+    if (isLayered)
+        gui::Shaders::activeShader->setInt("visibleSides", ReflectionCapturePool::Capture::ALL_SIDES);
 
-    //Restore the uniform values
-    gui::Shaders::update(scenes.back()->camera, scenes.back()->light);
+    //Transparent models need the skybox behind them before they are blended
+    if (pass.alpha < 1.0)
+        drawSkybox(pass.position);
+
+    //Draw the models
+    for (const CapturePass::Item& item : pass.items) {
+        if ((item.visibleSides & sides) == 0)
+            continue;
+        if (isLayered)
+            gui::Shaders::activeShader->setInt("visibleSides", item.visibleSides);
+
+        //Draw the model
+        if (pass.useProxyMeshes)
+            item.model->drawProxy(item.position, item.orientation, item.scale, pass.modelColor, pass.alpha);
+        else
+            item.model->draw(item.position, item.orientation, item.scale, pass.modelColor, pass.alpha);
+    }
+
+    //Draw the skybox where no model covers the sides (the static cubemap is still bound)
+    if (isLayered)
+        gui::Shaders::activeShader->setInt("visibleSides", ReflectionCapturePool::Capture::ALL_SIDES);
+    if (pass.alpha >= 1.0)
+        drawSkybox(pass.position);
+}
+
+void TestApp::updateProxyMeshes() {
+    //The small mirror images don't need the full detail. Proxies are generated for one model per frame, so a new threshold never stalls a frame
+    //with all models, and outdated proxies are drawn until they are replaced
+    if (!useProxyMeshes)
+        return;
+    for (AppModel& model : models) {
+        if (!model.mesh.proxyMeshes.empty() && model.proxyThreshold == proxyThreshold)
+            continue;
+        worker.waitUntilIdle();
+        model.mesh.generateProxy(proxyThreshold, proxyTargetError);
+        model.proxyThreshold = proxyThreshold;
+
+        //Change tracking invalidates the capture sides showing the model
+        model.isTracked = false;
+        return;
+    }
+}
+
+void TestApp::updateQualityGovernor() {
+    //The GPU time of the captures (of the main thread or the worker) tells whether the next level fits next to the rest of the frame.
+    //The level's budget limits both, the worker's jobs in flight only bound its latency
+    if (!governor.update(getDt(), 1.0 / targetFramerate, scheduler.measuredFrameTime))
+        return;
+
+    //Apply the new level, the pool resizes the captures on its next update
+    const ReflectionGovernor::Level& level = governor.getLevel();
+    capturePool.resolutionScale = level.resolutionScale;
+    scheduler.limitTime = true;
+    scheduler.timeBudget = level.timeBudget;
+    proxyThreshold = editedProxyThreshold = level.proxyThreshold;
+}
+
+void TestApp::renderReference() {
+    //The rasterized image is the screenshot of the scene, so both images have the same size and view
+    std::unique_ptr<ReferenceJob> job = std::make_unique<ReferenceJob>();
+    job->filePath = LENNY_PROJECT_FOLDER "/logs/Reference-" + tools::utils::getCurrentDateAndTime();
+    if (!saveScreenshot(job->filePath + "-gpu.png", job->rasterized, job->width, job->height))
+        return;
+
+    //Textures are read back once per job, like the environment
+    std::unordered_map<uint, std::shared_ptr<const tools::PathTracer::Texture>> textures;
+    const auto readTexture = [&](uint id) -> std::shared_ptr<const tools::PathTracer::Texture> {
+        if (const auto it = textures.find(id); it != textures.end())
+            return it->second;
+        std::shared_ptr<tools::PathTracer::Texture> texture = std::make_shared<tools::PathTracer::Texture>();
+        glBindTexture(GL_TEXTURE_2D, id);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &texture->width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &texture->height);
+        texture->texels.resize((size_t)texture->width * texture->height);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, texture->texels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return textures[id] = texture;
+    };
+
+    //Models in world coordinates, with the lobes of shader.frag (strengths of the light, the color, material or texture scaling both)
+    const gui::Light& light = scenes.back()->light;
+    const float phongRoughness = std::pow(2.f / (32.f + 2.f), 0.25f);  //GGX with about the width of the exponent of shader.frag
+    tools::PathTracer& pathTracer = job->pathTracer;
+    for (const AppModel& model : models) {
+        if (!showReferenceSphere && model.mesh.filePath.ends_with("sphere.obj"))
+            continue;
+        const glm::mat4 pose = gui::utils::getGLMTransform(model.position, model.orientation, model.scale);
+        const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(pose)));
+        for (const gui::Model::Mesh& mesh : model.mesh.meshes) {
+            std::vector<Eigen::Vector3f> positions, normals;
+            std::vector<Eigen::Vector2f> texCoords;
+            for (const gui::Model::Mesh::Vertex& vertex : mesh.getVertices()) {
+                const glm::vec3 position = glm::vec3(pose * glm::vec4(vertex.position, 1.f));
+                const glm::vec3 normal = normalMatrix * vertex.normal;
+                positions.emplace_back(position.x, position.y, position.z);
+                normals.emplace_back(normal.x, normal.y, normal.z);
+                texCoords.emplace_back(vertex.texCoords.x, vertex.texCoords.y);
+            }
+            const std::optional<gui::Model::Mesh::Material>& meshMaterial = mesh.getMaterial();
+            Eigen::Array3f diffuse = Eigen::Array3f::Ones(), specular = Eigen::Array3f::Ones();
+            tools::PathTracer::Material material;
+            if (!showMaterials) {
+                diffuse = specular = rendererColor.segment(0, 3).cast<float>().array();
+            } else if (meshMaterial.has_value() && meshMaterial->texture_diffuse) {
+                material.texture = readTexture(meshMaterial->texture_diffuse->id);
+            } else if (meshMaterial.has_value()) {
+                diffuse = Eigen::Array3f(meshMaterial->diffuse.x, meshMaterial->diffuse.y, meshMaterial->diffuse.z);
+                specular = Eigen::Array3f(meshMaterial->specular.x, meshMaterial->specular.y, meshMaterial->specular.z);
+            }
+            material.diffuse = diffuse * light.diffuseStrength;
+            material.specular = specular * light.specularStrength;
+            material.roughness = enableEnvironmentMapping ? reflectionRoughness : phongRoughness;  //Environment level of shader.frag if reflecting
+            pathTracer.addMesh(positions, normals, texCoords, mesh.getIndices(), material);
+        }
+    }
+
+    //A large plane for the ground
+    if (scenes.back()->showGround) {
+        const std::vector<Eigen::Vector3f> positions = {{-50.f, 0.f, -50.f}, {50.f, 0.f, -50.f}, {50.f, 0.f, 50.f}, {-50.f, 0.f, 50.f}};
+        pathTracer.addMesh(positions, std::vector<Eigen::Vector3f>(4, Eigen::Vector3f::UnitY()), {}, {0, 2, 1, 0, 3, 2}, tools::PathTracer::Material());
+    }
+    pathTracer.build();
+
+    //Light, camera and environment as seen by shader.frag (the light position is relative to the camera)
+    //The diffuse term of shader.frag is the albedo times the light color, which a Lambertian gets from pi times the light color
+    const gui::Camera& camera = scenes.back()->camera;
+    const glm::vec3 lightPosition = camera.getPosition() + light.getPosition();
+    const glm::vec3 lightColor = light.getColor() * (float)PI;
+    pathTracer.light = {Eigen::Vector3f(lightPosition.x, lightPosition.y, lightPosition.z), Eigen::Array3f(lightColor.x, lightColor.y, lightColor.z)};
+    const glm::mat4 inverseViewProjection = glm::inverse(camera.getProjectionMatrix() * camera.getViewMatrix());
+    tools::PathTracer::Camera view;
+    view.inverseViewProjection = Eigen::Map<const Eigen::Matrix4f>(&inverseViewProjection[0][0]);
+    if (staticCubemap.readback(job->environment))
+        pathTracer.environment = &job->environment;
+    pathTracer.samplesPerPixel = referenceSamples;
+
+    //Render without blocking the frames, a running job is stopped and replaced
+    job->timer.restart();
+    job->image = std::async(std::launch::async, [&pathTracer = job->pathTracer, view, width = job->width, height = job->height]() -> tools::PathTracer::Image {
+        return pathTracer.render(view, width, height);
+    });
+    referenceJob = std::move(job);
+}
+
+void TestApp::updateReference() {
+    if (!referenceJob || referenceJob->image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+
+    //Save and compare in the 8-bit range of the rasterized image
+    const double renderTime = referenceJob->timer.time();
+    tools::PathTracer::Image reference = referenceJob->image.get();
+    saveImage(referenceJob->filePath + "-reference.png", reference, referenceJob->width, referenceJob->height);
+    referenceError = tools::PathTracer::computeRMSE(referenceJob->rasterized, reference);
+    LENNY_LOG_INFO("Path traced %d triangles at %dx%d in %.2f s, RMSE of the rasterized image: %.4f", referenceJob->pathTracer.getNumTriangles(),
+                   referenceJob->width, referenceJob->height, renderTime, referenceError)
+    referenceJob = nullptr;
+}
+
+void TestApp::requestRasterizerComparison() {
+    //The ground is textured and the dynamic captures see the whole scene, so the compared frame shows the models, the skybox and the static reflections only
+    const gui::Scene::SPtr& scene = scenes.back();
+    rasterizerComparison = RasterizerComparison{frame + 1, scene->showGround, scene->showOrigin, enableDynamicReflections};
+    scene->showGround = scene->showOrigin = false;
+    enableDynamicReflections = false;
+}
+
+void TestApp::rasterizeOnCpu() {
+    //Same comparison as the reference renderer, but with the shading of shader.frag
+    const std::string filePath = LENNY_PROJECT_FOLDER "/logs/Rasterizer-" + tools::utils::getCurrentDateAndTime();
+    tools::SoftwareRasterizer::Image rasterized;
+    int width, height;
+    if (!saveScreenshot(filePath + "-gpu.png", rasterized, width, height))
+        return;
+
+    //Models with the color they are drawn with (materials without their ambient and specular color, textures are not sampled)
+    tools::SoftwareRasterizer rasterizer;
+    for (const AppModel& model : models) {
+        if (!showReferenceSphere && model.mesh.filePath.ends_with("sphere.obj"))
+            continue;
+        for (const gui::Model::Mesh& mesh : model.mesh.meshes) {
+            std::vector<Eigen::Vector3f> positions, normals;
+            for (const gui::Model::Mesh::Vertex& vertex : mesh.getVertices()) {
+                positions.emplace_back(vertex.position.x, vertex.position.y, vertex.position.z);
+                normals.emplace_back(vertex.normal.x, vertex.normal.y, vertex.normal.z);
+            }
+            Eigen::Vector4d color = rendererColor;
+            if (showMaterials && mesh.getMaterial().has_value())
+                color.segment(0, 3) = Eigen::Vector3d(mesh.getMaterial()->diffuse.x, mesh.getMaterial()->diffuse.y, mesh.getMaterial()->diffuse.z);
+            else if (showMaterials)
+                color.segment(0, 3) = Eigen::Vector3d::Ones();
+            rasterizer.drawMesh(positions, normals, mesh.getIndices(), model.position, model.orientation, model.scale, color);
+        }
+    }
+
+    //Light and the static environment as set for the models, which is also drawn as the skybox
+    const gui::Light& light = scenes.back()->light;
+    const glm::vec3 lightColor = light.getColor(), lightGlow = light.getGlow();
+    rasterizer.light.position = Eigen::Vector3f(light.getPosition().x, light.getPosition().y, light.getPosition().z);
+    rasterizer.light.color = Eigen::Array3f(lightColor.x, lightColor.y, lightColor.z);
+    rasterizer.light.glow = Eigen::Array3f(lightGlow.x, lightGlow.y, lightGlow.z);
+    rasterizer.light.ambientStrength = light.ambientStrength;
+    rasterizer.light.diffuseStrength = light.diffuseStrength;
+    rasterizer.light.specularStrength = light.specularStrength;
+    tools::Cubemap environment;
+    if (staticCubemap.readback(environment))
+        rasterizer.environment.cubemap = &environment;
+    rasterizer.environment.enableMapping = enableEnvironmentMapping;
+    rasterizer.environment.mappingType = environmentMappingType;
+    rasterizer.environment.lod = getEnvironmentLod();
+    if (enableEnvironmentMapping && useIrradiance)
+        rasterizer.environment.irradiance = staticCubemap.irradiance;
+
+    const gui::Camera& camera = scenes.back()->camera;
+    const glm::mat4 view = camera.getViewMatrix(), projection = camera.getProjectionMatrix();
+    tools::SoftwareRasterizer::Camera rasterizerCamera;
+    rasterizerCamera.position = Eigen::Vector3f(camera.getPosition().x, camera.getPosition().y, camera.getPosition().z);
+    rasterizerCamera.view = Eigen::Map<const Eigen::Matrix4f>(&view[0][0]);
+    rasterizerCamera.projection = Eigen::Map<const Eigen::Matrix4f>(&projection[0][0]);
+
+    tools::Timer timer;
+    timer.restart();
+    tools::SoftwareRasterizer::Image image = rasterizer.render(rasterizerCamera, width, height);
+    const double renderTime = timer.time();
+    saveImage(filePath + "-cpu.png", image, width, height);
+    rasterizerError = tools::PathTracer::computeRMSE(rasterized, image);
+    LENNY_LOG_INFO("Rasterized %d triangles at %dx%d in %.2f ms, RMSE of the GPU image: %.4f", rasterizer.getNumTriangles(), width, height, 1000.0 * renderTime,
+                   rasterizerError)
+}
+
+bool TestApp::saveScreenshot(const std::string& filePath, std::vector<Eigen::Array4f>& image, int& width, int& height) const {
+    //Read directly and saved like the other images, so the image is exactly what ends up in the file
+    std::vector<unsigned char> pixels;
+    scenes.back()->readScreenshot(pixels, width, height);
+    if (pixels.empty()) {
+        LENNY_LOG_WARNING("Screenshot for `%s` is empty", filePath.c_str())
+        return false;
+    }
+    image.resize(width * height);
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = Eigen::Array4f(pixels[3 * i], pixels[3 * i + 1], pixels[3 * i + 2], 255.f) / 255.f;
+    return saveImage(filePath, image, width, height);
+}
+
+bool TestApp::saveImage(const std::string& filePath, std::vector<Eigen::Array4f>& image, int width, int height) {
+    //Clamped to the 8-bit range of the screenshots, in place so comparisons see the saved values
+    std::vector<unsigned char> pixels(3 * width * height);
+    for (size_t i = 0; i < image.size(); i++) {
+        image[i] = image[i].min(1.f).max(0.f);
+        for (int c = 0; c < 3; c++)
+            pixels[3 * i + c] = (unsigned char)std::lround(image[i][c] * 255.f);
+    }
+
+    //The first row is the bottom one, like in the screenshots of the scenes
+    stbi_flip_vertically_on_write(true);
+    if (!stbi_write_png(filePath.c_str(), width, height, 3, pixels.data(), 3 * width)) {
+        LENNY_LOG_WARNING("Could not save image into file `%s`", filePath.c_str())
+        return false;
+    }
+    return true;
+}
+
+TestApp::CaptureSettings TestApp::getCaptureSettings() const {
+    const gui::Light& light = scenes.back()->light;
+    return {rendererColor,
+            showMaterials,
+            showReferenceSphere,
+            enableEnvironmentMapping,
+            useProxyMeshes,
+            useIrradiance,
+            environmentMappingType,
+            reflectionRoughness,
+            light.position,
+            light.color,
+            light.colorIntensity,
+            light.glowIntensity,
+            light.ambientStrength,
+            light.diffuseStrength,
+            light.specularStrength};
+}
+
+bool TestApp::isVisibleInCaptures(int modelIndex) const {
+    return showReferenceSphere || !models[modelIndex].mesh.filePath.ends_with("sphere.obj");
+}
+
+double TestApp::getScreenSize(int modelIndex) const {
+    //Projected diameter of the model's bounding sphere in pixels of the current viewport
+    const gui::Camera& camera = scenes.back()->camera;
+    const AppModel& model = models[modelIndex];
+    const gui::Model::BoundingSphere bounds = model.mesh.getBoundingSphere(model.position, model.orientation, model.scale);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    //A camera inside the bounds sees the model everywhere
+    const float distance = glm::distance(camera.getPosition(), bounds.center);
+    if (distance <= bounds.radius)
+        return (double)std::max(viewport[2], viewport[3]);
+    return (double)(bounds.radius / distance * camera.getProjectionMatrix()[1][1]) * viewport[3];
+}
+
+float TestApp::getEnvironmentLod() const {
+    //Only the static cubemap has a prefiltered mip chain, textures without mipmaps ignore the level
+    return reflectionRoughness * (float)(staticCubemap.numLevels - 1);
+}
+
+void TestApp::setIrradiance(const tools::SphericalHarmonics& irradiance, bool isEnabled) {
+    //Shaders evaluate the irradiance directly, so the convolution happens once here
+    gui::Shaders::activeShader->setBool("useIrradiance", isEnabled);
+    const std::array<Eigen::Array4f, 9> coefficients = irradiance.getIrradianceCoefficients();
+    for (int i = 0; i < 9; i++)
+        gui::Shaders::activeShader->setVec3("irradianceSH[" + std::to_string(i) + "]", coefficients[i][0], coefficients[i][1], coefficients[i][2]);
+}
+
+std::list<ReflectionCapturePool::Capture>& TestApp::getActiveCaptures() {
+    return useProbeGrid ? probeGrid.probes : capturePool.captures;
+}
+
+void TestApp::updateIrradiance() {
+    //Reading a capture back waits for its rendering, so captures are projected once after the environment changed, and one per frame at most.
+    //Captures are small, so the projection runs on this thread instead of starting workers
+    if (!enableEnvironmentMapping || !useIrradiance)
+        return;
+    tools::Cubemap cubemap;
+    for (ReflectionCapturePool::Capture& capture : getActiveCaptures()) {
+        if (capture.lastUsedFrame != frame || !capture.isComplete || capture.dirtySides != 0 || capture.pendingJob != 0 || capture.irradiance.has_value())
+            continue;
+        if (capture.cubemap.readback(cubemap)) {
+            capture.irradiance = tools::SphericalHarmonics::project(cubemap, 1);
+            break;
+        }
+    }
+}
+
+tools::SphericalHarmonics TestApp::getIrradiance(const ReflectionCapturePool::Capture* capture, const glm::vec3& position) const {
+    //Blend the projected probes like their reflections (the coefficients are linear in the radiance)
+    if (enableDynamicReflections && useProbeGrid) {
+        const ReflectionProbeGrid::Blend blend = probeGrid.getBlend(position);
+        tools::SphericalHarmonics irradiance;
+        float weight = 0.f;
+        for (int j = 0; j < blend.numProbes; j++) {
+            if (!blend.probes[j]->irradiance)
+                continue;
+            for (int i = 0; i < 9; i++)
+                irradiance.coefficients[i] += blend.weights[j] * blend.probes[j]->irradiance->coefficients[i];
+            weight += blend.weights[j];
+        }
+        if (weight <= 0.f)
+            return staticCubemap.irradiance;
+        for (int i = 0; i < 9; i++)
+            irradiance.coefficients[i] /= weight;
+        return irradiance;
+    }
+
+    //Captures that were not projected yet (or have no cubemap mapping) use the static environment
+    if (capture && capture->irradiance)
+        return *capture->irradiance;
+    return staticCubemap.irradiance;
+}
+
+void TestApp::updateChangeTracking() {
+    //Settings changes are visible in every capture
+    const CaptureSettings settings = getCaptureSettings();
+    const bool settingsChanged = (lastCaptureSettings != settings);
+    lastCaptureSettings = settings;
+
+    //Diffuse light changes little when models move, so the irradiance of the captures is only projected again when the environment changed
+    if (settingsChanged)
+        for (std::list<ReflectionCapturePool::Capture>* captures : {&capturePool.captures, &probeGrid.probes})
+            for (ReflectionCapturePool::Capture& capture : *captures)
+                capture.irradiance.reset();
+
+    //Detect transform changes from the guizmo, file drops or processes, and collect the bounds before and after each change
+    std::vector<std::pair<int, gui::Model::BoundingSphere>> changedBounds;
+    for (int j = 0; j < (int)models.size(); j++) {
+        AppModel& model = models[j];
+        const bool wasTracked = model.isTracked;
+        const gui::Model::BoundingSphere previousBounds = model.mesh.getBoundingSphere(model.trackedPosition, model.trackedOrientation, model.trackedScale);
+        model.hasChanged = model.updateChangeState();
+        if (!model.hasChanged || !isVisibleInCaptures(j))
+            continue;
+
+        if (wasTracked)
+            changedBounds.emplace_back(model.id, previousBounds);
+        changedBounds.emplace_back(model.id, model.mesh.getBoundingSphere(model.position, model.orientation, model.scale));
+    }
+
+    //A capture side is invalid if something it sees changed (moving view points are handled by the pool)
+    for (ReflectionCapturePool::Capture& capture : getActiveCaptures()) {
+        if (settingsChanged) {
+            capture.dirtySides = ReflectionCapturePool::Capture::ALL_SIDES;
+            continue;
+        }
+        for (const auto& [modelId, bounds] : changedBounds)
+            if (!capture.isUsedBy(modelId))
+                capture.dirtySides |= DynamicCubemap::getVisibleSides(capture.position, bounds.center, bounds.radius);
+
+        //Maps without sides are re-rendered as a whole
+        if (capture.dirtySides != 0 && capture.cubemap.mapping != DynamicCubemap::CUBE)
+            capture.dirtySides = ReflectionCapturePool::Capture::ALL_SIDES;
+    }
 }
 
 void TestApp::drawScene() {
@@ -191,14 +754,72 @@ void TestApp::drawScene() {
     gui::Shaders::activeShader->activate();
     gui::Shaders::activeShader->setBool("enableEnvironmentMapping", enableEnvironmentMapping);
     gui::Shaders::activeShader->setInt("environmentMappingType", environmentMappingType);
+    gui::Shaders::activeShader->setFloat("environmentLod", getEnvironmentLod());
 
     //Activate the cubemap texture unit
     gui::Shaders::activeShader->setInt("texture_cubemap", 1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, enableDynamicReflections ? dynamicCubemap.texture : staticCubemap.texture);
+    setIrradiance(staticCubemap.irradiance, enableEnvironmentMapping && useIrradiance);
 
-    //Draw the skybox
-    drawSkybox();
+    //Create the dropped models that finished loading and save a finished reference image
+    updatePendingModels();
+    updateReference();
+
+    //Get a capture for each model from the pool, or use the probe grid for all models (the unused one is released)
+    updateQualityGovernor();
+    updateProxyMeshes();
+    updateChangeTracking();
+    frame++;
+    std::vector<ReflectionCapturePool::Capture*> captures(models.size(), nullptr);
+    if (enableDynamicReflections && useProbeGrid) {
+        capturePool.clear();
+        if (probeGrid.probes.empty())
+            probeGrid.create();
+        std::vector<ReflectionProbeGrid::Occluder> probeModels;
+        for (int i = 0; i < (int)models.size(); i++) {
+            if (!isVisibleInCaptures(i))
+                continue;
+            const gui::Model::BoundingSphere bounds = models[i].mesh.getBoundingSphere(models[i].position, models[i].orientation, models[i].scale);
+            probeModels.push_back({models[i].id, bounds.center, bounds.radius});
+        }
+        probeGrid.use(frame, probeModels);
+    } else if (enableDynamicReflections) {
+        probeGrid.destroy();
+        for (int i = 0; i < (int)models.size(); i++)
+            if (isVisibleInCaptures(i))
+                captures[i] =
+                    capturePool.acquire(models[i].id, gui::utils::toGLM(models[i].position), getScreenSize(i), models[i].captureMapping,
+                                        models[i].captureFormat, frame);
+        capturePool.updateMaps(frame);
+    }
+
+    //Re-render only the captures whose surroundings changed, spread over frames within the time budget
+    skippedCaptures = 0;
+    for (const ReflectionCapturePool::Capture& capture : getActiveCaptures())
+        if (capture.lastUsedFrame == frame && capture.dirtySides == 0)
+            skippedCaptures++;
+    bool isRendered = false;
+    if (useWorkerThread) {
+        updateCapturesOnWorker();
+    } else {
+        scheduler.update(getActiveCaptures(), frame,
+                         [&](ReflectionCapturePool::Capture& capture, int side) -> void { updateReflectionCapture(capture, side); });
+        executedCaptures = scheduler.renderedCaptures;
+        isRendered = scheduler.renderedSides > 0;
+    }
+    updateIrradiance();
+    totalExecutedCaptures += executedCaptures;
+    totalSkippedCaptures += skippedCaptures;
+
+    //Restore the uniform values
+    if (isRendered)
+        gui::Shaders::update(scenes.back()->camera, scenes.back()->light);
+
+    //Transparent models need the skybox behind them before they are blended
+    const glm::vec3 cameraPosition = scenes.back()->camera.getPosition();
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, staticCubemap.texture);
+    if (rendererColor[3] < 1.0)
+        drawSkybox(cameraPosition);
 
     //Draw the models
     std::optional<Eigen::Vector3d> modelColor = std::nullopt;
@@ -209,19 +830,109 @@ void TestApp::drawScene() {
         if (!showReferenceSphere && models[i].mesh.filePath.ends_with("sphere.obj"))
             continue;
 
-        //Update the cubemap texture for this model if checked
-        if (enableDynamicReflections)
-            updateDynamicCubemap(i);
+        //Use the capture of this model if checked (the static cubemap if it did not fit into the budget or is not rendered completely yet)
+        if (captures[i] && !captures[i]->isComplete)
+            captures[i] = nullptr;
+        if (captures[i] && captures[i]->cubemap.mapping == DynamicCubemap::DUAL_PARABOLOID) {
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, captures[i]->cubemap.texture);
+        } else if (captures[i] && captures[i]->cubemap.mapping == DynamicCubemap::OCTAHEDRAL) {
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, captures[i]->cubemap.texture);
+        } else {
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, captures[i] ? captures[i]->cubemap.texture : staticCubemap.texture);
+        }
+        gui::Shaders::activeShader->setInt("environmentParameterization", captures[i] ? (int)captures[i]->cubemap.mapping : (int)DynamicCubemap::CUBE);
+
+        //Blend the nearest probes of the grid if checked
+        if (enableDynamicReflections && useProbeGrid) {
+            const ReflectionProbeGrid::Blend blend = probeGrid.getBlend(gui::utils::toGLM(models[i].position)).getComplete();
+            for (int j = 0; j < blend.numProbes; j++) {
+                glActiveTexture(GL_TEXTURE4 + j);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, blend.probes[j]->cubemap.texture);
+                gui::Shaders::activeShader->setFloat("probeWeights[" + std::to_string(j) + "]", blend.weights[j]);
+            }
+            gui::Shaders::activeShader->setInt("numProbes", blend.numProbes);
+        }
+
+        //Diffuse environment light of the model's surroundings
+        setIrradiance(getIrradiance(captures[i], gui::utils::toGLM(models[i].position)), enableEnvironmentMapping && useIrradiance);
 
         //Draw the model
         models[i].mesh.draw(models[i].position, models[i].orientation, models[i].scale, modelColor, rendererColor[3]);
     }
 
+    //Draw the skybox where no model covers the screen, the models bound their captures to the cubemap unit
+    if (rendererColor[3] >= 1.0) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, staticCubemap.texture);
+        drawSkybox(cameraPosition);
+    }
+
     //Disable environment mapping for ground (rendered by LennyGraphics)
     gui::Shaders::activeShader->setBool("enableEnvironmentMapping", false);
+    gui::Shaders::activeShader->setInt("environmentParameterization", DynamicCubemap::CUBE);
+    gui::Shaders::activeShader->setInt("numProbes", 0);
+    gui::Shaders::activeShader->setBool("useIrradiance", false);
+
+    //Draw the placeholders of the models that are still loading (blended over the skybox), unless the frame is compared with the software rasterizer
+    if (!rasterizerComparison)
+        drawPendingModels();
+}
+
+void TestApp::updatePendingModels() {
+    //Adding models moves them, so the worker (drawing them by address) has to finish and the selection is restored by index
+    while (std::optional<gui::ModelLoader::Result> result = modelLoader.poll()) {
+        const auto it = std::find_if(pendingModels.begin(), pendingModels.end(),
+                                     [&](const PendingModel& pending) -> bool { return pending.ticket == result->ticket; });
+        if (it == pendingModels.end())
+            continue;
+        worker.waitUntilIdle();
+        const std::ptrdiff_t selectedIndex = selectedModel ? selectedModel - models.data() : -1;
+        models.emplace_back(it->filePath, std::move(result->data), it->position, Eigen::QuaternionD::Identity(), 1.0);
+        selectedModel = selectedIndex >= 0 ? &models[selectedIndex] : nullptr;
+        pendingModels.erase(it);
+    }
+}
+
+void TestApp::drawPendingModels() const {
+    //A translucent box at the drop position, filled up to the load progress
+    for (const PendingModel& pending : pendingModels) {
+        const double progress = (double)modelLoader.getProgress(pending.ticket);
+        const double size = 0.2;
+        tools::Renderer::I->drawCuboid(pending.position, Eigen::QuaternionD::Identity(), Eigen::Vector3d::Constant(size),
+                                       Eigen::Vector4d(0.75, 0.75, 0.75, 0.25));
+        if (progress > 0.0)
+            tools::Renderer::I->drawCuboid(pending.position - Eigen::Vector3d(0.0, 0.5 * size * (1.0 - progress), 0.0), Eigen::QuaternionD::Identity(),
+                                           Eigen::Vector3d(0.9 * size, size * progress, 0.9 * size), Eigen::Vector4d(0.2, 0.6, 1.0, 0.75));
+    }
+}
+
+Eigen::Vector3d TestApp::getDropPosition(double spacing) const {
+    //Step along the x-axis until neither a model nor a placeholder is closer than the spacing
+    std::vector<Eigen::Vector3d> occupied;
+    for (const AppModel& model : models)
+        occupied.push_back(model.position);
+    for (const PendingModel& pending : pendingModels)
+        occupied.push_back(pending.position);
+    for (int i = 0;; i++) {
+        const Eigen::Vector3d position(spacing * (double)i, 0.0, 0.0);
+        if (std::none_of(occupied.begin(), occupied.end(), [&](const Eigen::Vector3d& other) -> bool { return (other - position).norm() < spacing; }))
+            return position;
+    }
 }
 
 void TestApp::drawGui() {
+    //The scenes are drawn before the GUI, so the requested frame is on screen now
+    if (rasterizerComparison && frame >= rasterizerComparison->frame) {
+        rasterizeOnCpu();
+        scenes.back()->showGround = rasterizerComparison->showGround;
+        scenes.back()->showOrigin = rasterizerComparison->showOrigin;
+        enableDynamicReflections = rasterizerComparison->enableDynamicReflections;
+        rasterizerComparison = std::nullopt;
+    }
+
     ImGui::Begin("Menu");
 
     ImGui::Checkbox("Show materials", &showMaterials);
@@ -230,6 +941,37 @@ void TestApp::drawGui() {
 
     ImGui::Checkbox("Show reference sphere", &showReferenceSphere);
 
+    //Progress of the dropped models that are still loading
+    for (const PendingModel& pending : pendingModels)
+        ImGui::ProgressBar(modelLoader.getProgress(pending.ticket), ImVec2(-1.0f, 0.0f), std::filesystem::path(pending.filePath).filename().string().c_str());
+    ImGui::Text("Shared files: %d, textures: %d", gui::AssetRegistry::getNumMeshes(), gui::AssetRegistry::getNumTextures());
+
+    //Specialized variants instead of the runtime branches of shader.frag
+    ImGui::Checkbox("Shader permutations", &gui::Shader::usePermutations);
+    if (gui::Shader::usePermutations)
+        ImGui::Text("Compiled variants: %d", gui::Shaders::activeShader->getNumVariants());
+
+    //Ground truth of the current view, the screenshot and the reference are saved to the logs folder
+    if (ImGui::TreeNode("Reference renderer")) {
+        ImGui::SliderInt("Samples per pixel", &referenceSamples, 1, 256);
+        if (ImGui::Button(referenceJob ? "Restart with current view" : "Path trace current view"))
+            renderReference();
+        if (referenceJob)
+            ImGui::ProgressBar(referenceJob->pathTracer.getProgress(), ImVec2(-1.0f, 0.0f));
+        if (referenceError >= 0.0)
+            ImGui::Text("RMSE of the rasterized image: %.4f", referenceError);
+        ImGui::TreePop();
+    }
+
+    //CPU rasterization of the current view with the same shading, saved next to the screenshot
+    if (ImGui::TreeNode("Software rasterizer")) {
+        if (ImGui::Button("Rasterize current view on the CPU") && !rasterizerComparison)
+            requestRasterizerComparison();
+        if (rasterizerError >= 0.0)
+            ImGui::Text("RMSE of the GPU image: %.4f", rasterizerError);
+        ImGui::TreePop();
+    }
+
     ImGui::Separator();
 
     //Checkbox for environment mapping
@@ -256,6 +998,90 @@ void TestApp::drawGui() {
         ImGui::RadioButton("Mix", &environmentMappingType, 3);
         ImGui::Unindent();
 
+        //Roughness selects the level of the prefiltered static cubemap
+        ImGui::SliderFloat("Roughness", &reflectionRoughness, 0.0f, 1.0f);
+
+        //Ambient light from the environment instead of the light color
+        ImGui::Checkbox("Diffuse irradiance (SH9)", &useIrradiance);
+
+        //Statistics of the dynamic reflection captures
+        if (enableDynamicReflections) {
+            ImGui::Text("Captures");
+            ImGui::Indent();
+            ImGui::Checkbox("Single-pass layered rendering", &useLayeredRendering);
+            //Mapping of the selected model's capture, or of all captures if none is selected
+            ImGui::Text(selectedModel ? "Mapping (selected model)" : "Mapping (all models)");
+            int mapping = selectedModel ? selectedModel->captureMapping : (models.empty() ? DynamicCubemap::CUBE : models.front().captureMapping);
+            bool mappingChanged = ImGui::RadioButton("Cubemap (6 sides)", &mapping, DynamicCubemap::CUBE);
+            mappingChanged |= ImGui::RadioButton("Dual paraboloid (2 sides)", &mapping, DynamicCubemap::DUAL_PARABOLOID);
+            mappingChanged |= ImGui::RadioButton("Octahedral (1 side)", &mapping, DynamicCubemap::OCTAHEDRAL);
+            if (mappingChanged)
+                for (AppModel& model : models)
+                    if (!selectedModel || selectedModel == &model)
+                        model.captureMapping = (DynamicCubemap::MAPPING)mapping;
+            //Storage format of the selected model's capture, or of all captures if none is selected
+            int format = selectedModel ? selectedModel->captureFormat : (models.empty() ? DynamicCubemap::RGB8 : models.front().captureFormat);
+            if (ImGui::Combo(selectedModel ? "Format (selected model)" : "Format (all models)", &format, "RGB8\0R11G11B10F\0RGBA16F\0"))
+                for (AppModel& model : models)
+                    if (!selectedModel || selectedModel == &model)
+                        model.captureFormat = (DynamicCubemap::FORMAT)format;
+            ImGui::Checkbox("Proxy meshes", &useProxyMeshes);
+            if (useProxyMeshes) {
+                //Regenerate the proxies once the slider is released
+                ImGui::SliderFloat("Proxy detail", &editedProxyThreshold, 0.01f, 1.0f);
+                if (ImGui::IsItemDeactivatedAfterEdit())
+                    proxyThreshold = editedProxyThreshold;
+            }
+            if (ImGui::Checkbox("Render on worker thread", &useWorkerThread) && !useWorkerThread)
+                stopWorker();
+            if (useWorkerThread) {
+                ImGui::SliderInt("Jobs in flight", &maxPendingJobs, 1, 8);
+                ImGui::Text("Pending jobs: %d", worker.getNumPending());
+            } else {
+                scheduler.drawGui();
+            }
+            governor.drawGui();
+            ImGui::Text("Executed: %d (total %llu)", executedCaptures, (unsigned long long)totalExecutedCaptures);
+            ImGui::Text("Skipped: %d (total %llu)", skippedCaptures, (unsigned long long)totalSkippedCaptures);
+            ImGui::Unindent();
+
+            //Per-model captures or a fixed grid of probes
+            ImGui::Text("Reflection source");
+            ImGui::Indent();
+            if (ImGui::RadioButton("Capture per model", !useProbeGrid))
+                useProbeGrid = false;
+            if (ImGui::RadioButton("Probe grid", useProbeGrid))
+                useProbeGrid = true;
+            if (useProbeGrid)
+                probeGrid.drawGui();
+            ImGui::Unindent();
+
+            //Settings and statistics of the capture pool
+            ImGui::Text("Capture pool");
+            ImGui::Indent();
+            ImGui::SliderDouble("Memory budget (MB)", &capturePool.memoryBudget, 1.0, 512.0);
+            ImGui::SliderDouble("Sharing distance", &capturePool.sharingDistance, 0.0, 2.0);
+            ImGui::Text("Captures: %d (%.1f MB)", (int)capturePool.captures.size(), (double)capturePool.getUsedMemory() / (1024.0 * 1024.0));
+            ImGui::SliderDouble("Resolution scale", &capturePool.resolutionScale, 0.1, 2.0);
+            for (int resolution : capturePool.resolutions) {
+                const int count = (int)std::count_if(capturePool.captures.begin(), capturePool.captures.end(),
+                                                     [&](const ReflectionCapturePool::Capture& capture) -> bool { return capture.cubemap.width == resolution; });
+                ImGui::Text("%dx%d: %d", resolution, resolution, count);
+            }
+            //VRAM of the captures and the probe grid together
+            const char* formatNames[] = {"RGB8", "R11G11B10F", "RGBA16F"};
+            for (int format = DynamicCubemap::RGB8; format <= DynamicCubemap::RGBA16F; format++)
+                ImGui::Text("%s: %.1f MB (%d bytes per texel)", formatNames[format],
+                            (double)(capturePool.getUsedMemory((DynamicCubemap::FORMAT)format) + probeGrid.getUsedMemory((DynamicCubemap::FORMAT)format)) /
+                                (1024.0 * 1024.0),
+                            DynamicCubemap::getBytesPerTexel((DynamicCubemap::FORMAT)format));
+            ImGui::Text("Total: %.1f MB", (double)(capturePool.getUsedMemory() + probeGrid.getUsedMemory()) / (1024.0 * 1024.0));
+            ImGui::Text("Resizes: %llu", (unsigned long long)capturePool.numResizes);
+            ImGui::Text("Evictions: %llu", (unsigned long long)capturePool.numEvictions);
+            ImGui::Text("Over budget: %llu", (unsigned long long)capturePool.numRejections);
+            ImGui::Unindent();
+        }
+
         ImGui::Unindent();
     }
 
@@ -281,7 +1107,19 @@ void TestApp::mouseButtonCallback(double xPos, double yPos, Ray ray, int button,
 }
 
 void TestApp::fileDropCallback(int count, const char** fileNames) {
-    models.emplace_back(fileNames[count - 1], Eigen::Vector3d::Zero(), Eigen::QuaternionD::Identity(), 1.0);
+    //Radiance and equirectangular images replace the environment, other images are skipped and everything else is loaded as a model in the background
+    for (int i = 0; i < count; i++) {
+        const std::string fileName = fileNames[i];
+        bool isImage = false;
+        for (const char* extension : {"hdr", "png", "jpg"})
+            isImage |= tools::utils::checkFileExtension(fileName, extension);
+        if (isImage && StaticCubemap::isEquirectangular(fileName))
+            loadEnvironment(fileName);
+        else if (isImage)
+            LENNY_LOG_WARNING("Image `%s` is neither a radiance file nor an equirectangular map (2:1)", fileName.c_str())
+        else
+            pendingModels.push_back({modelLoader.request(fileName), fileName, getDropPosition()});
+    }
 }
 
 }  // namespace lenny
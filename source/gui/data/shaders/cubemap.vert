@@ -0,0 +1,19 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec3 vFragPos;
+out vec3 vNormal;
+out vec2 vTexCoords;
+
+uniform mat4 modelPose;
+
+void main()
+{
+    //Projection happens per cubemap side in the geometry shader
+    vFragPos = vec3(modelPose * vec4(aPos, 1.0));
+    vNormal = vec3(transpose(inverse(modelPose)) * vec4(aNormal, 0));
+    vTexCoords = aTexCoords;
+}
@@ -31,22 +31,62 @@ uniform float objectAlpha;
 
 uniform Strength strength;
 
+//Variants replace these uniforms by constants (see Shader::Permutation), so the compiler removes the unused branches
+#ifdef STATIC_useMaterial
+const bool useMaterial = bool(STATIC_useMaterial);
+#else
 uniform bool useMaterial;
-uniform Material material;
-
+#endif
+#ifdef STATIC_useTexture
+const bool useTexture = bool(STATIC_useTexture);
+#else
 uniform bool useTexture;
-uniform sampler2D texture_diffuse;
-
+#endif
+#ifdef STATIC_isSkybox
+const bool isSkybox = bool(STATIC_isSkybox);
+#else
 uniform bool isSkybox;
+#endif
+#ifdef STATIC_enableEnvironmentMapping
+const bool enableEnvironmentMapping = bool(STATIC_enableEnvironmentMapping);
+#else
 uniform bool enableEnvironmentMapping;
+#endif
+#ifdef STATIC_environmentMappingType
+const int environmentMappingType = STATIC_environmentMappingType;
+#else
 uniform int environmentMappingType;
+#endif
+
+uniform Material material;
+uniform sampler2D texture_diffuse;
 uniform samplerCube texture_cubemap;
+uniform float environmentLod;  //Level of the prefiltered mip chain, higher levels are rougher
+uniform int environmentParameterization;  //0: cubemap, 1: dual paraboloid, 2: octahedral
+uniform sampler2DArray texture_paraboloid;
+uniform sampler2D texture_octahedral;
+uniform int numProbes;  //Blend reflection probes instead of a single environment map if > 0
+uniform samplerCube texture_probes[4];
+uniform float probeWeights[4];
+uniform bool useIrradiance;  //Diffuse environment light from spherical harmonics instead of the light color as ambient term
+uniform vec3 irradianceSH[9];  //Coefficients already convolved with the clamped cosine
 
 vec3 getLightDir(){
     return normalize((cameraPosition + lightPosition) - FragPos);
 }
 
+vec3 computeIrradiance(vec3 n){
+    //Order 2 spherical harmonics basis, in the order of tools::SphericalHarmonics
+    return max(0.282095 * irradianceSH[0]
+        + 0.488603 * (irradianceSH[1] * n.y + irradianceSH[2] * n.z + irradianceSH[3] * n.x)
+        + 1.092548 * (irradianceSH[4] * n.x * n.y + irradianceSH[5] * n.y * n.z + irradianceSH[7] * n.x * n.z)
+        + 0.315392 * irradianceSH[6] * (3.0 * n.z * n.z - 1.0)
+        + 0.546274 * irradianceSH[8] * (n.x * n.x - n.y * n.y), vec3(0.0));
+}
+
 vec3 computeAmbientComponent(){
+    if (useIrradiance)
+        return strength.ambient * computeIrradiance(normalize(Normal));
     return strength.ambient * lightColor;
 }
 
@@ -79,11 +119,34 @@ vec3 computeGlowDirection(vec3 direction, vec3 color, vec3 normal) {
     return diffuse;
 }
 
+vec4 sampleEnvironment(vec3 dir){
+    if (numProbes > 0) {
+        vec4 color = vec4(0.0);
+        for (int i = 0; i < 4; i++)
+            if (i < numProbes)
+                color += probeWeights[i] * texture(texture_probes[i], dir);
+        return color;
+    } else if (environmentParameterization == 1) {
+        //Layer 0 holds the +z hemisphere, layer 1 the -z hemisphere
+        float side = (dir.z >= 0.0) ? 1.0 : -1.0;
+        vec2 uv = dir.xy / (1.0 + side * dir.z) * 0.5 + 0.5;
+        return texture(texture_paraboloid, vec3(uv, side > 0.0 ? 0.0 : 1.0));
+    } else if (environmentParameterization == 2) {
+        //Project onto the octahedron and unfold the lower half onto the corners
+        vec3 n = dir / (abs(dir.x) + abs(dir.y) + abs(dir.z));
+        vec2 uv = n.xy;
+        if (n.z < 0.0)
+            uv = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        return texture(texture_octahedral, uv * 0.5 + 0.5);
+    }
+    return textureLod(texture_cubemap, dir, environmentLod);
+}
+
 void main()
 {
-    //Use texturing without shading for skybox
+    //Sample the static cubemap without shading for skybox, in the direction from the view point
     if (isSkybox) {
-        FragColor = texture(texture_diffuse, TexCoords);
+        FragColor = textureLod(texture_cubemap, FragPos - cameraPosition, 0.0);
         return;
     }
 
@@ -116,8 +179,8 @@ void main()
         //Ray reflection using surface normal
         rayDir = reflect(rayDir, norm);
 
-        //Get environment color from the cubemap
-        vec4 envColor = texture(texture_cubemap, rayDir);
+        //Get environment color from the chosen parameterization
+        vec4 envColor = sampleEnvironment(rayDir);
 
         // fragment brightness;
         float brightness = clamp((FragColor.r + FragColor.g + FragColor.b) / 3.0, 0.0, 1.0);
@@ -11,6 +11,7 @@ out vec2 TexCoords;
 uniform mat4 modelPose;
 uniform mat4 cameraView;
 uniform mat4 cameraProjection;
+uniform bool isSkybox;  //Drawn at maximum depth, behind everything else
 
 void main()
 {
@@ -19,4 +20,6 @@ void main()
     TexCoords = aTexCoords;
 
     gl_Position = cameraProjection * cameraView * vec4(FragPos, 1.0);
+    if (isSkybox)
+        gl_Position.z = gl_Position.w;
 }
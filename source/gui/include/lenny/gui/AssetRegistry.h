@@ -0,0 +1,46 @@
+#pragma once
+
+#include <lenny/gui/Model.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace lenny::gui {
+
+/**
+ * Meshes and textures of the loaded files, shared by all models using the same file.
+ * Only weak references are kept, the GL objects are deleted when the last model using them is gone.
+ */
+class AssetRegistry {
+private:  //Make constructor private, since we want to this to be a purely static class
+    AssetRegistry() = default;
+    ~AssetRegistry() = default;
+
+public:
+    typedef std::shared_ptr<const std::vector<Model::Mesh>> Meshes;
+    typedef std::shared_ptr<const Model::Mesh::Texture> Texture;
+
+    //--- Meshes (find and add on the thread with the GL context, the last reference deletes the GL objects)
+    static bool hasMeshes(const std::string& filePath);                                       //Without taking a reference, safe on any thread
+    static Meshes findMeshes(const std::string& filePath);                                    //Empty if no model of this file is alive
+    static Meshes addMeshes(const std::string& filePath, std::vector<Model::Mesh>&& meshes);  //Returns the meshes that were registered first
+
+    //--- Textures
+    static bool hasTexture(const std::string& filePath);
+    static Texture findTexture(const std::string& filePath);
+    static Texture addTexture(const std::string& filePath, uint id);  //Deletes the texture if another one of this file was registered first
+
+    //--- Statistics
+    static int getNumMeshes();  //Of the files in use
+    static int getNumTextures();
+
+private:
+    static std::string getKey(const std::string& filePath);
+
+private:
+    static inline std::mutex mutex;  //Lookups also come from the loader threads
+    static inline std::unordered_map<std::string, std::weak_ptr<const std::vector<Model::Mesh>>> meshes;
+    static inline std::unordered_map<std::string, std::weak_ptr<const Model::Mesh::Texture>> textures;
+};
+
+}  // namespace lenny::gui
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <lenny/gui/Model.h>
+#include <lenny/tools/MappedFile.h>
+
+namespace lenny::gui {
+
+/**
+ * Post-processed meshes of a model file: vertices and indices in the layout of Model::Mesh, and the material colors with the names of their textures.
+ * Opened containers are memory-mapped, so the buffers can be uploaded without importing or copying.
+ */
+class MeshContainer {
+public:
+    typedef Model::Data::Material Material;
+    typedef Model::Data::ImportedMesh Mesh;
+
+    MeshContainer() = default;
+    MeshContainer(MeshContainer&&) noexcept = default;
+    ~MeshContainer() = default;
+
+    MeshContainer& operator=(MeshContainer&&) noexcept = default;
+
+    //--- Key
+    static uint64_t getKey(const std::string& filePath, uint flags);  //Of the file contents (and the material libraries OBJ files reference) and the import flags
+    static std::string getFilePath(uint64_t key);                      //In the cache folder of the project
+
+    //--- Writing
+    static bool write(const std::string& filePath, uint64_t key, const std::vector<Mesh>& meshes, const std::vector<Material>& materials);
+
+    //--- Reading
+    bool open(const std::string& filePath, uint64_t key);  //Fails for files of another format or key
+    void close();
+    bool isOpen() const;
+    int getNumMeshes() const;
+    const Model::Mesh::Vertex* getVertices(int mesh) const;
+    uint getNumVertices(int mesh) const;
+    const uint* getIndices(int mesh) const;
+    uint getNumIndices(int mesh) const;
+    int getMaterialIndex(int mesh) const;
+    int getNumMaterials() const;
+    Material getMaterial(int material) const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint64_t key;
+        uint32_t numMeshes, numMaterials;
+        uint64_t vertexSize;  //Rejects containers written with another vertex layout
+    };
+    struct MeshEntry {
+        uint64_t vertexOffset, indexOffset;  //From the start of the file
+        uint32_t numVertices, numIndices;
+        int32_t materialIndex;
+        uint32_t padding;
+    };
+    struct MaterialEntry {
+        float ambient[3], diffuse[3], specular[3];
+        uint32_t textureNameLength;
+        uint64_t textureNameOffset;  //From the start of the file
+    };
+
+    const MeshEntry& getMeshEntry(int mesh) const;
+
+    tools::MappedFile file;
+    Header header = {};
+};
+
+}  // namespace lenny::gui
@@ -3,9 +3,12 @@
 #include <lenny/tools/Model.h>
 
 #include <glm/glm.hpp>
+#include <mutex>
 
 namespace lenny::gui {
 
+class MeshContainer;
+
 class Model : public tools::Model {
 public:
     class Mesh {
@@ -20,17 +23,28 @@ public:
             }
         };
 
+        struct Texture {  //Deleted with the last material using it
+            explicit Texture(uint id) : id(id) {}
+            Texture(const Texture &) = delete;
+            ~Texture();
+
+            Texture &operator=(const Texture &) = delete;
+
+            const uint id;
+        };
+
         struct Material {
             glm::vec3 ambient = glm::vec3(0.3f);
             glm::vec3 diffuse = glm::vec3(0.8f);
             glm::vec3 specular = glm::vec3(0.5f);
 
-            std::optional<uint> texture_diffuse = std::nullopt;
+            std::shared_ptr<const Texture> texture_diffuse = nullptr;
         };
 
     public:
         Mesh(const std::vector<Vertex> &vertices, const std::vector<uint> &indices);
         Mesh(const std::vector<Vertex> &vertices, const std::vector<uint> &indices, const Material &material);
+        Mesh(const Vertex *vertices, size_t numVertices, const uint *indices, size_t numIndices, const std::optional<Material> &material);
         ~Mesh() = default;
 
         void draw(const std::optional<Eigen::Vector3d> &color) const;
@@ -39,19 +53,61 @@ public:
         const std::vector<uint>& getIndices() const;
         const std::optional<Material>& getMaterial() const;
 
+        static inline thread_local bool isSharedContext = false;  //Set by a thread drawing with a second context that shares the buffers
+        static void deleteSharedContextArrays();  //Of the deleted meshes, called by the thread drawing with the second context
+
     private:
-        void setup();
+        void setup(const Vertex *vertexData, const uint *indexData);
+        void setupVertexArray(uint vertexArray) const;
+        uint getVertexArray() const;
 
     private:
-        std::vector<Vertex> vertices;
-        std::vector<uint> indices;
+        struct Buffers;  //Vertices, indices and their GL objects, shared by the copies of a mesh and deleted with the last one
+
+        std::shared_ptr<Buffers> buffers;
         std::optional<Material> material;
-        uint VAO, VBO, EBO;
+
+        static inline std::mutex sharedContextMutex;  //Meshes are deleted on the main thread while the other thread draws
+        static inline std::vector<uint> deletedSharedContextArrays;
+    };
+
+    struct BoundingSphere {
+        glm::vec3 center = glm::vec3(0, 0, 0);
+        float radius = 0.f;
     };
 
+    /**
+     * CPU side of loading a model file, produced without a GL context (see ModelLoader) and uploaded by the model constructor
+     */
+    struct Data {
+        struct Texture {
+            int width = 0, height = 0, numComponents = 0;
+            std::vector<unsigned char> pixels;
+        };
+
+        struct Material {
+            Mesh::Material colors;    //Without texture, the name is resolved by the model
+            std::string textureName;  //Relative to the model file, empty if there is none
+        };
+
+        struct ImportedMesh {
+            std::vector<Mesh::Vertex> vertices;
+            std::vector<uint> indices;
+            int materialIndex = -1;  //None if negative
+        };
+
+        std::shared_ptr<MeshContainer> container = nullptr;  //Mapped on a cache hit, the buffers are uploaded from it
+        std::vector<ImportedMesh> meshes;                     //Imported on a cache miss
+        std::vector<Material> materials;                      //Of both
+        std::vector<std::optional<Texture>> textures;         //Decoded diffuse texture of each material, unless another model uses it
+        bool isShared = false;                                //Nothing was loaded, the meshes of the file are in use by another model
+    };
+    typedef std::function<void(float progress)> F_progress;  //In [0, 1]
+
 public:
     Model(const std::vector<Mesh> &meshes);
     Model(const std::string &filePath);
+    Model(const std::string &filePath, Data &&data);  //Only uploads
     ~Model() = default;
 
     static inline typename tools::Model::F_loadModel f_loadModel = [](tools::Model::UPtr &model, const std::string &filePath) -> void {
@@ -61,15 +117,31 @@ public:
     void draw(const Eigen::Vector3d &position, const Eigen::QuaternionD &orientation, const Eigen::Vector3d &scale, const std::optional<Eigen::Vector3d> &color,
               const double &alpha) const override;
 
+    void drawProxy(const Eigen::Vector3d &position, const Eigen::QuaternionD &orientation, const Eigen::Vector3d &scale, const std::optional<Eigen::Vector3d> &color,
+                   const double &alpha) const;
+
     std::optional<HitInfo> hitByRay(const Eigen::Vector3d &position, const Eigen::QuaternionD &orientation, const Eigen::Vector3d &scale,
                                     const Ray &ray) const override;
 
     void load(const std::string &filePath);
+    static Data loadData(const std::string &filePath, const F_progress &f_progress = nullptr);  //Without GL calls, safe on any thread
     bool exportAsOBJ() const;
     void simplify(const float &threshold, const float &targetError, const bool &saveToFile);
+    void generateProxy(const float &threshold, const float &targetError);
+
+    BoundingSphere getBoundingSphere(const Eigen::Vector3d &position, const Eigen::QuaternionD &orientation, const Eigen::Vector3d &scale) const;
+
+private:
+    void upload(const std::string &filePath, Data &data);
+    void updateBounds();
 
 public:
     std::vector<Mesh> meshes;
+    std::vector<Mesh> proxyMeshes;  //Reduced-detail copies of the meshes for secondary passes, empty until generated
+    BoundingSphere bounds;  //In model coordinates, updated whenever the meshes change
+
+private:
+    std::shared_ptr<const std::vector<Mesh>> sharedMeshes = nullptr;  //Registered meshes of the file, shared with the other models of the same file
 };
 
 }  // namespace lenny::gui
\ No newline at end of file
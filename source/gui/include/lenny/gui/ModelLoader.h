@@ -0,0 +1,52 @@
+#pragma once
+
+#include <lenny/gui/Model.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace lenny::gui {
+
+/**
+ * Thread pool for the CPU side of loading models: importing (or mapping the cached meshes) and decoding textures.
+ * Finished data is queued for the thread with the GL context, which creates the models from it.
+ */
+class ModelLoader {
+public:
+    struct Result {
+        uint64_t ticket;
+        std::string filePath;
+        Model::Data data;
+    };
+
+    ModelLoader(int numThreads = 0);  //All cores if <= 0, started with the first request
+    ModelLoader(const ModelLoader&) = delete;
+    ~ModelLoader();  //Finishes the running jobs, pending ones are dropped
+
+    ModelLoader& operator=(const ModelLoader&) = delete;
+
+    uint64_t request(const std::string& filePath);  //Returns the ticket of the result immediately
+    std::optional<Result> poll();                   //Any finished result, without blocking
+    std::optional<Result> wait(uint64_t ticket);    //Blocks until this result is finished, empty if it was already taken
+    int getNumUnfinished() const;
+    float getProgress(uint64_t ticket) const;  //0 while pending, 1 once finished
+
+private:
+    void run();
+
+private:
+    const int numThreads;
+    std::vector<std::thread> threads;
+    mutable std::mutex mutex;
+    std::condition_variable jobAdded, jobFinished;
+    std::deque<std::pair<uint64_t, std::string>> jobs;
+    std::deque<Result> results;
+    std::unordered_map<uint64_t, float> unfinishedTickets;  //Pending or running, with their progress
+    uint64_t nextTicket = 1;
+    bool isStopping = false;
+};
+
+}  // namespace lenny::gui
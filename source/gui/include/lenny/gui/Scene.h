@@ -33,6 +33,7 @@ public:
     void copyCallbacksFromOtherScene(const Scene::CSPtr otherScene);
     void sync(const Scene::CSPtr otherScene);
     bool saveScreenshotToFile(const std::string& filePath) const;
+    void readScreenshot(std::vector<unsigned char>& pixels, int& width, int& height) const;  //RGB of the window size, the bottom row first
 
 public:
     //--- Functions
@@ -1,16 +1,30 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace lenny::gui {
 
 class Shader {
 public:
-    Shader(const std::string &vertexPath, const std::string &fragmentPath);
+    //Bool or int uniform of the fragment shader that variants replace by the constant STATIC_<name>, so its branches are compiled out
+    struct Permutation {
+        std::string name;
+        int numValues;  //Values outside of [0, numValues) use the generic program
+    };
+
+    Shader(const std::string &vertexPath, const std::string &fragmentPath, const std::string &geometryPath = "",
+           const std::vector<Permutation> &permutations = {});
     ~Shader() = default;
 
     void activate() const;
+    void release();  //Deletes the programs of all variants, copies share them so this is not done by the destructor
+    void selectProgram() const;  //Switches to the variant of the current permutation values (the generic program until it is compiled), call before each draw
+    bool compileNextVariant();   //Compiles one of the variants selected so far, returns false if none is missing
 
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
@@ -25,17 +39,51 @@ public:
     void setMat3(const std::string &name, const glm::mat3 &mat) const;
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
 
-    unsigned int getID() const;
+    unsigned int getID() const;  //Of the program in use
+    int getNumVariants() const;
+
+public:
+    static inline bool usePermutations = true;
 
 private:
-    void load(const std::string &vertexPath, const std::string &fragmentPath);
-    void getCodeFromFile(std::string &code, const std::string &path) const;
+    //Last value of each uniform, replayed when switching to a program that missed it
+    struct Uniform {
+        enum TYPE { INT, FLOAT, VEC2, VEC3, VEC4, MAT2, MAT3, MAT4 } type;
+        std::array<float, 16> values;  //Column-major for matrices
+        int intValue;
+        uint64_t version;
+    };
+    struct Variant {
+        unsigned int ID;
+        uint64_t version;  //Of the last uniform set while this program was in use
+        std::unordered_map<std::string, int> locations = {};  //Of the uniforms applied so far, -1 if compiled out
+    };
+
+    void set(const std::string &name, const Uniform &uniform) const;
+    void apply(Variant &variant, const std::string &name, const Uniform &uniform) const;
+    void apply(int location, const Uniform &uniform) const;
+
+    unsigned int load(const std::string &defines) const;
+    void getCodeFromFile(std::string &code, const std::string &path, const std::string &defines = "") const;
 
     void checkShaderCompilationErrors(const unsigned int shader, const std::string& type) const;
     void checkProgramCompilationErrors(const unsigned int program) const;
 
 private:
-    unsigned int ID;  //Set in load function
+    std::string vertexPath, fragmentPath, geometryPath;
+    std::vector<Permutation> permutations;
+    unsigned int ID;  //Generic program, set in the constructor
+
+    //Programs and uniform state (updated by the const setters)
+    mutable std::vector<int> permutationValues;
+    mutable std::unordered_map<uint32_t, Variant> variants;  //By the mixed-radix key of the permutation values, including the generic program
+    mutable std::vector<uint32_t> missingKeys;               //Selected but not compiled yet, in the order of their first use
+    mutable std::unordered_map<std::string, Uniform> uniforms;
+    mutable uint64_t version = 0;
+    mutable uint32_t currentKey = GENERIC;  //Of the program in use
+    mutable unsigned int currentID;
+
+    static constexpr uint32_t GENERIC = UINT32_MAX;  //Key of the generic program
 };
 
 }  // namespace lenny::gui
\ No newline at end of file
@@ -14,15 +14,19 @@ private:  //Make constructor private, since we want to this to be a purely stati
     ~Shaders() = default;
 
 private:
-    static std::vector<Shader> shaderList;
+    static thread_local std::vector<Shader> shaderList;  //Per thread, so a thread with a shared context has its own programs and uniforms
 
 public:
-    enum SHADERS { BASIC };
-    static Shader* activeShader;
+    enum SHADERS { BASIC, CUBEMAP, PARABOLOID, OCTAHEDRAL };
+    static thread_local Shader* activeShader;
 
 public:
     static void initialize();
+    static std::vector<Shader> detach();              //Takes the programs of this thread, e.g. to keep them while a thread with a shared context restarts
+    static void attach(std::vector<Shader>&& shaders);  //Uses detached programs on this thread instead of initializing
     static void update(const Camera& camera, const Light& light);
+    static void compileNextVariant();  //Compiles one variant missing on this thread, call once per frame outside of drawing
+    static void updateLight(const Light& light);
     static void setActiveShader(SHADERS shader);
 };
 
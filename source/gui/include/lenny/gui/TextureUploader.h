@@ -0,0 +1,28 @@
+#pragma once
+
+#include <lenny/tools/Definitions.h>
+
+#include <cstddef>
+
+namespace lenny::gui {
+
+/**
+ * Uploads decoded pixels into immutable textures through a pixel buffer object.
+ * The copy into the texture is queued on the GPU, a call returns once the pixels are staged instead of when they are in the texture.
+ */
+class TextureUploader {
+private:  //Make constructor private, since we want to this to be a purely static class
+    TextureUploader() = default;
+    ~TextureUploader() = default;
+
+public:
+    static uint createTexture(uint target, uint internalFormat, int width, int height, int numLevels);  //Immutable storage, left bound
+    static void upload(uint target, int level, int width, int height, uint format, uint type, const void* pixels, size_t numBytes);  //Into the bound texture
+    static int getNumLevels(int width, int height);  //Of a full mip chain
+    static void release();                           //Deletes the pixel buffer, with the context still current
+
+private:
+    static inline uint buffer = 0;  //Orphaned before every copy, so a pending transfer never blocks the next one
+};
+
+}  // namespace lenny::gui
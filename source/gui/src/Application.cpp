@@ -6,6 +6,7 @@
 #include <lenny/gui/Plot.h>
 #include <lenny/gui/Renderer.h>
 #include <lenny/gui/Shaders.h>
+#include <lenny/gui/TextureUploader.h>
 #include <lenny/tools/Logger.h>
 #include <lenny/tools/Timer.h>
 //#define STB_IMAGE_IMPLEMENTATION
@@ -27,6 +28,9 @@ Application::Application(const std::string &title, const std::string &iconPath)
 }
 
 Application::~Application() {
+    //Delete what is shared by all textures, while the context still exists
+    TextureUploader::release();
+
     //Terminate ImGui
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -0,0 +1,91 @@
+#include <lenny/gui/AssetRegistry.h>
+
+#include <algorithm>
+#include <filesystem>
+
+namespace lenny::gui {
+
+template <typename T>
+inline std::shared_ptr<const T> find(std::unordered_map<std::string, std::weak_ptr<const T>>& entries, const std::string& key) {
+    const auto it = entries.find(key);
+    if (it == entries.end())
+        return nullptr;
+    std::shared_ptr<const T> entry = it->second.lock();
+    if (!entry)
+        entries.erase(it);
+    return entry;
+}
+
+template <typename T>
+inline bool contains(const std::unordered_map<std::string, std::weak_ptr<const T>>& entries, const std::string& key) {
+    const auto it = entries.find(key);
+    return it != entries.end() && !it->second.expired();
+}
+
+template <typename T>
+inline void eraseExpired(std::unordered_map<std::string, std::weak_ptr<const T>>& entries) {
+    std::erase_if(entries, [](const auto& entry) -> bool { return entry.second.expired(); });
+}
+
+bool AssetRegistry::hasMeshes(const std::string& filePath) {
+    std::scoped_lock lock(mutex);
+    return contains(meshes, getKey(filePath));
+}
+
+AssetRegistry::Meshes AssetRegistry::findMeshes(const std::string& filePath) {
+    std::scoped_lock lock(mutex);
+    return find(meshes, getKey(filePath));
+}
+
+AssetRegistry::Meshes AssetRegistry::addMeshes(const std::string& filePath, std::vector<Model::Mesh>&& meshes) {
+    std::scoped_lock lock(mutex);
+    const std::string key = getKey(filePath);
+    if (Meshes registered = find(AssetRegistry::meshes, key))
+        return registered;
+    eraseExpired(AssetRegistry::meshes);
+    Meshes added = std::make_shared<const std::vector<Model::Mesh>>(std::move(meshes));
+    AssetRegistry::meshes[key] = added;
+    return added;
+}
+
+bool AssetRegistry::hasTexture(const std::string& filePath) {
+    std::scoped_lock lock(mutex);
+    return contains(textures, getKey(filePath));
+}
+
+AssetRegistry::Texture AssetRegistry::findTexture(const std::string& filePath) {
+    std::scoped_lock lock(mutex);
+    return find(textures, getKey(filePath));
+}
+
+AssetRegistry::Texture AssetRegistry::addTexture(const std::string& filePath, uint id) {
+    Texture added = std::make_shared<const Model::Mesh::Texture>(id);
+    std::scoped_lock lock(mutex);
+    const std::string key = getKey(filePath);
+    if (Texture registered = find(textures, key))
+        return registered;
+    eraseExpired(textures);
+    textures[key] = added;
+    return added;
+}
+
+int AssetRegistry::getNumMeshes() {
+    std::scoped_lock lock(mutex);
+    eraseExpired(meshes);
+    return (int)meshes.size();
+}
+
+int AssetRegistry::getNumTextures() {
+    std::scoped_lock lock(mutex);
+    eraseExpired(textures);
+    return (int)textures.size();
+}
+
+std::string AssetRegistry::getKey(const std::string& filePath) {
+    //Different spellings of the same path share the entry
+    std::string path(filePath);
+    std::replace(path.begin(), path.end(), '\\', '/');
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+}  // namespace lenny::gui
@@ -0,0 +1,216 @@
+#include <lenny/gui/MeshContainer.h>
+#include <lenny/tools/Logger.h>
+#include <lenny/tools/Utils.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <thread>
+
+namespace lenny::gui {
+
+inline uint64_t alignOffset(uint64_t offset) {
+    //Buffers start at 16 bytes, the mapping itself is page aligned
+    return (offset + 15) & ~(uint64_t)15;
+}
+
+inline bool isInFile(uint64_t offset, uint64_t numBytes, size_t fileSize) {
+    return offset <= fileSize && numBytes <= fileSize - offset;
+}
+
+inline std::vector<std::string> getMaterialLibraries(std::string_view obj) {
+    //The rest of each `mtllib` line is one file name, like the OBJ importer reads it
+    std::vector<std::string> names;
+    for (size_t begin = 0; begin < obj.size();) {
+        size_t end = obj.find('\n', begin);
+        if (end == std::string_view::npos)
+            end = obj.size();
+        std::string_view line = obj.substr(begin, end - begin);
+        begin = end + 1;
+
+        const size_t first = line.find_first_not_of(" \t");
+        if (first == std::string_view::npos || line.substr(first, 6) != "mtllib" || first + 6 >= line.size() || (line[first + 6] != ' ' && line[first + 6] != '\t'))
+            continue;
+        line = line.substr(first + 7);
+        const size_t nameBegin = line.find_first_not_of(" \t");
+        const size_t nameEnd = line.find_last_not_of(" \t\r");
+        if (nameBegin != std::string_view::npos)
+            names.emplace_back(line.substr(nameBegin, nameEnd - nameBegin + 1));
+    }
+    return names;
+}
+
+uint64_t MeshContainer::getKey(const std::string& filePath, uint flags) {
+    //Contents instead of the modification time, so checkouts and copies of the same file share the cache
+    uint64_t key = tools::utils::hash(&flags, sizeof(flags));
+    tools::MappedFile source;
+    if (source.open(filePath))
+        key = tools::utils::hash(source.getData(), source.getSize(), key);
+
+    //Material libraries the OBJ file references, adding or editing them later also changes the key
+    if (source.getData() && (tools::utils::checkFileExtension(filePath, "obj") || tools::utils::checkFileExtension(filePath, "OBJ"))) {
+        const std::filesystem::path directory = std::filesystem::path(filePath).parent_path();
+        for (const std::string& libraryName : getMaterialLibraries(std::string_view((const char*)source.getData(), source.getSize()))) {
+            tools::MappedFile library;
+            const bool hasLibrary = library.open((directory / libraryName).string());
+            key = tools::utils::hash(libraryName.data(), libraryName.size(), key);
+            key = tools::utils::hash(&hasLibrary, sizeof(hasLibrary), key);
+            if (hasLibrary)
+                key = tools::utils::hash(library.getData(), library.getSize(), key);
+        }
+    }
+    return key;
+}
+
+std::string MeshContainer::getFilePath(uint64_t key) {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+    return LENNY_PROJECT_FOLDER "/cache/meshes/" + std::string(name) + ".lmesh";
+}
+
+bool MeshContainer::write(const std::string& filePath, uint64_t key, const std::vector<Mesh>& meshes, const std::vector<Material>& materials) {
+    //Written under a name of this thread and renamed when complete, so loaders of the same file never map a partial container
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(filePath).parent_path(), error);
+    const std::string temporaryPath = filePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary);
+    if (!file.is_open()) {
+        LENNY_LOG_WARNING("Could not open file `%s` for writing", temporaryPath.c_str());
+        return false;
+    }
+
+    //Tables first, then the texture names and the buffers of all meshes
+    Header header = {};
+    std::memcpy(header.magic, "LNYMESH1", 8);
+    header.key = key;
+    header.numMeshes = (uint32_t)meshes.size();
+    header.numMaterials = (uint32_t)materials.size();
+    header.vertexSize = sizeof(Model::Mesh::Vertex);
+    uint64_t offset = sizeof(Header) + meshes.size() * sizeof(MeshEntry) + materials.size() * sizeof(MaterialEntry);
+
+    std::vector<MaterialEntry> materialEntries(materials.size());
+    for (size_t i = 0; i < materials.size(); i++) {
+        const Model::Mesh::Material& colors = materials[i].colors;
+        for (int c = 0; c < 3; c++) {
+            materialEntries[i].ambient[c] = colors.ambient[c];
+            materialEntries[i].diffuse[c] = colors.diffuse[c];
+            materialEntries[i].specular[c] = colors.specular[c];
+        }
+        materialEntries[i].textureNameLength = (uint32_t)materials[i].textureName.size();
+        materialEntries[i].textureNameOffset = offset;
+        offset += materials[i].textureName.size();
+    }
+
+    std::vector<MeshEntry> meshEntries(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        meshEntries[i].numVertices = (uint32_t)meshes[i].vertices.size();
+        meshEntries[i].numIndices = (uint32_t)meshes[i].indices.size();
+        meshEntries[i].materialIndex = meshes[i].materialIndex;
+        meshEntries[i].vertexOffset = offset = alignOffset(offset);
+        offset += meshes[i].vertices.size() * sizeof(Model::Mesh::Vertex);
+        meshEntries[i].indexOffset = offset = alignOffset(offset);
+        offset += meshes[i].indices.size() * sizeof(uint);
+    }
+
+    file.write((const char*)&header, sizeof(Header));
+    file.write((const char*)meshEntries.data(), (std::streamsize)(meshEntries.size() * sizeof(MeshEntry)));
+    file.write((const char*)materialEntries.data(), (std::streamsize)(materialEntries.size() * sizeof(MaterialEntry)));
+    for (const Material& material : materials)
+        file.write(material.textureName.data(), (std::streamsize)material.textureName.size());
+    const char padding[16] = {};
+    for (size_t i = 0; i < meshes.size(); i++) {
+        file.write(padding, (std::streamsize)(meshEntries[i].vertexOffset - (uint64_t)file.tellp()));
+        file.write((const char*)meshes[i].vertices.data(), (std::streamsize)(meshes[i].vertices.size() * sizeof(Model::Mesh::Vertex)));
+        file.write(padding, (std::streamsize)(meshEntries[i].indexOffset - (uint64_t)file.tellp()));
+        file.write((const char*)meshes[i].indices.data(), (std::streamsize)(meshes[i].indices.size() * sizeof(uint)));
+    }
+    file.close();
+    if (!file.good()) {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    std::filesystem::rename(temporaryPath, filePath, error);
+    if (!error)
+        return true;
+    std::filesystem::remove(temporaryPath, error);
+    return false;
+}
+
+bool MeshContainer::open(const std::string& filePath, uint64_t key) {
+    close();
+    if (!file.open(filePath))
+        return false;
+
+    //Reject files of another format, layout or key, and files that are too short for their tables and buffers
+    std::memcpy(&header, file.getData(), std::min(sizeof(Header), file.getSize()));
+    bool isValid = file.getSize() >= sizeof(Header) && std::memcmp(header.magic, "LNYMESH1", 8) == 0 && header.key == key &&
+                   header.vertexSize == sizeof(Model::Mesh::Vertex) &&
+                   isInFile(sizeof(Header), (uint64_t)header.numMeshes * sizeof(MeshEntry) + (uint64_t)header.numMaterials * sizeof(MaterialEntry), file.getSize());
+    for (int i = 0; isValid && i < getNumMeshes(); i++) {
+        const MeshEntry& entry = getMeshEntry(i);
+        isValid = entry.vertexOffset % 16 == 0 && entry.indexOffset % 16 == 0 && entry.materialIndex < (int32_t)header.numMaterials &&
+                  isInFile(entry.vertexOffset, (uint64_t)entry.numVertices * sizeof(Model::Mesh::Vertex), file.getSize()) &&
+                  isInFile(entry.indexOffset, (uint64_t)entry.numIndices * sizeof(uint), file.getSize());
+    }
+    const MaterialEntry* materialEntries = (const MaterialEntry*)(file.getData() + sizeof(Header) + header.numMeshes * sizeof(MeshEntry));
+    for (int i = 0; isValid && i < getNumMaterials(); i++)
+        isValid = isInFile(materialEntries[i].textureNameOffset, materialEntries[i].textureNameLength, file.getSize());
+    if (!isValid)
+        close();
+    return isValid;
+}
+
+void MeshContainer::close() {
+    file.close();
+    header = {};
+}
+
+bool MeshContainer::isOpen() const {
+    return file.isOpen();
+}
+
+int MeshContainer::getNumMeshes() const {
+    return (int)header.numMeshes;
+}
+
+const Model::Mesh::Vertex* MeshContainer::getVertices(int mesh) const {
+    return (const Model::Mesh::Vertex*)(file.getData() + getMeshEntry(mesh).vertexOffset);
+}
+
+uint MeshContainer::getNumVertices(int mesh) const {
+    return getMeshEntry(mesh).numVertices;
+}
+
+const uint* MeshContainer::getIndices(int mesh) const {
+    return (const uint*)(file.getData() + getMeshEntry(mesh).indexOffset);
+}
+
+uint MeshContainer::getNumIndices(int mesh) const {
+    return getMeshEntry(mesh).numIndices;
+}
+
+int MeshContainer::getMaterialIndex(int mesh) const {
+    return getMeshEntry(mesh).materialIndex;
+}
+
+int MeshContainer::getNumMaterials() const {
+    return (int)header.numMaterials;
+}
+
+MeshContainer::Material MeshContainer::getMaterial(int material) const {
+    const MaterialEntry& entry = ((const MaterialEntry*)(file.getData() + sizeof(Header) + header.numMeshes * sizeof(MeshEntry)))[material];
+    Material result;
+    result.colors.ambient = glm::vec3(entry.ambient[0], entry.ambient[1], entry.ambient[2]);
+    result.colors.diffuse = glm::vec3(entry.diffuse[0], entry.diffuse[1], entry.diffuse[2]);
+    result.colors.specular = glm::vec3(entry.specular[0], entry.specular[1], entry.specular[2]);
+    result.textureName = std::string((const char*)file.getData() + entry.textureNameOffset, entry.textureNameLength);
+    return result;
+}
+
+const MeshContainer::MeshEntry& MeshContainer::getMeshEntry(int mesh) const {
+    return ((const MeshEntry*)(file.getData() + sizeof(Header)))[mesh];
+}
+
+}  // namespace lenny::gui
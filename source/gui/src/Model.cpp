@@ -1,6 +1,11 @@
+#include <GLFW/glfw3.h>
 #include <glad/glad.h>
+#include <lenny/gui/AssetRegistry.h>
+#include <lenny/gui/MeshContainer.h>
 #include <lenny/gui/Model.h>
+#include <lenny/gui/ModelLoader.h>
 #include <lenny/gui/Shaders.h>
+#include <lenny/gui/TextureUploader.h>
 #include <lenny/gui/Utils.h>
 #include <lenny/tools/Utils.h>
 
@@ -14,6 +19,7 @@
 
 #include <assimp/Exporter.hpp>
 #include <assimp/Importer.hpp>
+#include <assimp/ProgressHandler.hpp>
 #include <glm/gtx/hash.hpp>
 #include <glm/gtx/intersect.hpp>
 #include <unordered_map>
@@ -29,13 +35,51 @@ struct hash<lenny::gui::Model::Mesh::Vertex> {
 
 namespace lenny::gui {
 
-Model::Mesh::Mesh(const std::vector<Vertex> &vertices, const std::vector<uint> &indices) : vertices(vertices), indices(indices) {
-    setup();
+struct Model::Mesh::Buffers {
+    Buffers(std::vector<Vertex> vertices, std::vector<uint> indices) : vertices(std::move(vertices)), indices(std::move(indices)) {}
+    Buffers(const Buffers &) = delete;
+    ~Buffers() {
+        //Static models outlive the context, their objects are gone with it
+        if (glfwGetCurrentContext()) {
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+        }
+
+        //Vertex arrays only exist in the context that created them, so the one of the shared context is deleted by the thread drawing with it
+        if (sharedContextVAO != 0) {
+            std::lock_guard<std::mutex> lock(sharedContextMutex);
+            deletedSharedContextArrays.emplace_back(sharedContextVAO);
+        }
+    }
+
+    Buffers &operator=(const Buffers &) = delete;
+
+    std::vector<Vertex> vertices;
+    std::vector<uint> indices;
+    uint VAO = 0, VBO = 0, EBO = 0;
+    uint sharedContextVAO = 0;  //Vertex arrays are not shared between contexts, created on the first draw in the shared context
+};
+
+Model::Mesh::Texture::~Texture() {
+    if (glfwGetCurrentContext())
+        glDeleteTextures(1, &id);
+}
+
+Model::Mesh::Mesh(const std::vector<Vertex> &vertices, const std::vector<uint> &indices) : buffers(std::make_shared<Buffers>(vertices, indices)) {
+    setup(vertices.data(), indices.data());
 }
 
 Model::Mesh::Mesh(const std::vector<Vertex> &vertices, const std::vector<uint> &indices, const Material &material)
-    : vertices(vertices), indices(indices), material(material) {
-    setup();
+    : buffers(std::make_shared<Buffers>(vertices, indices)), material(material) {
+    setup(vertices.data(), indices.data());
+}
+
+Model::Mesh::Mesh(const Vertex *vertices, size_t numVertices, const uint *indices, size_t numIndices, const std::optional<Material> &material)
+    : buffers(std::make_shared<Buffers>(std::vector<Vertex>(vertices, vertices + numVertices), std::vector<uint>(indices, indices + numIndices))),
+      material(material) {
+    //Uploaded from the source (e.g. a mapped file) instead of the copies kept for picking and simplification
+    setup(vertices, indices);
 }
 
 void Model::Mesh::draw(const std::optional<Eigen::Vector3d> &color) const {
@@ -44,11 +88,11 @@ void Model::Mesh::draw(const std::optional<Eigen::Vector3d> &color) const {
     Shaders::activeShader->setBool("useMaterial", false);
     if (color.has_value()) {  //Use color
         Shaders::activeShader->setVec3("objectColor", utils::toGLM(color.value()));
-    } else if (material.has_value() && material->texture_diffuse.has_value()) {                   //Use texture
+    } else if (material.has_value() && material->texture_diffuse) {                               //Use texture
         Shaders::activeShader->setBool("useTexture", true);                                       //Choose first texture from list
         glActiveTexture(GL_TEXTURE0);                                                             //Active proper texture unit before binding
-        glUniform1i(glGetUniformLocation(Shaders::activeShader->getID(), "texture_diffuse"), 0);  //Set the sampler to the correct texture unit
-        glBindTexture(GL_TEXTURE_2D, material->texture_diffuse.value());                          //Bind the texture
+        Shaders::activeShader->setInt("texture_diffuse", 0);                                      //Set the sampler to the correct texture unit
+        glBindTexture(GL_TEXTURE_2D, material->texture_diffuse->id);                              //Bind the texture
     } else if (material.has_value()) {                                                            //Use material
         Shaders::activeShader->setBool("useMaterial", true);
         Shaders::activeShader->setVec3("material.ambient", material.value().ambient);
@@ -58,44 +102,52 @@ void Model::Mesh::draw(const std::optional<Eigen::Vector3d> &color) const {
         Shaders::activeShader->setVec3("objectColor", utils::toGLM(Eigen::Vector3d::Ones()));
     }
 
-    //Draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, nullptr);
+    //Draw mesh with the program specialized for the uniforms set above
+    Shaders::activeShader->selectProgram();
+    glBindVertexArray(getVertexArray());
+    glDrawElements(GL_TRIANGLES, (GLsizei)buffers->indices.size(), GL_UNSIGNED_INT, nullptr);
     glBindVertexArray(0);
 }
 
 const std::vector<Model::Mesh::Vertex> &Model::Mesh::getVertices() const {
-    return vertices;
+    return buffers->vertices;
 }
 
 const std::vector<uint> &Model::Mesh::getIndices() const {
-    return indices;
+    return buffers->indices;
 }
 
 const std::optional<Model::Mesh::Material> &Model::Mesh::getMaterial() const {
     return material;
 }
 
-void Model::Mesh::setup() {
+void Model::Mesh::setup(const Vertex *vertexData, const uint *indexData) {
     //Create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    glGenVertexArrays(1, &buffers->VAO);
+    glGenBuffers(1, &buffers->VBO);
+    glGenBuffers(1, &buffers->EBO);
 
     //Bind and load data
-    glBindVertexArray(VAO);
-
-    //Update vertices and indices info
-    if (vertices.size() > 0) {
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBindVertexArray(buffers->VAO);
+    if (buffers->vertices.size() > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers->VBO);
+        glBufferData(GL_ARRAY_BUFFER, buffers->vertices.size() * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
     }
 
-    if (indices.size() > 0) {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint), &indices[0], GL_STATIC_DRAW);
+    if (buffers->indices.size() > 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffers->indices.size() * sizeof(uint), indexData, GL_STATIC_DRAW);
     }
 
+    setupVertexArray(buffers->VAO);
+}
+
+void Model::Mesh::setupVertexArray(uint vertexArray) const {
+    //Bind the array and the buffers
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->EBO);
+
     //Set the vertex attribute pointers for ...
     //... positions
     glEnableVertexAttribArray(0);
@@ -113,14 +165,37 @@ void Model::Mesh::setup() {
     glBindVertexArray(0);
 }
 
+void Model::Mesh::deleteSharedContextArrays() {
+    std::lock_guard<std::mutex> lock(sharedContextMutex);
+    if (!deletedSharedContextArrays.empty())
+        glDeleteVertexArrays((GLsizei)deletedSharedContextArrays.size(), deletedSharedContextArrays.data());
+    deletedSharedContextArrays.clear();
+}
+
+uint Model::Mesh::getVertexArray() const {
+    if (!isSharedContext)
+        return buffers->VAO;
+    if (buffers->sharedContextVAO == 0) {
+        glGenVertexArrays(1, &buffers->sharedContextVAO);
+        setupVertexArray(buffers->sharedContextVAO);
+    }
+    return buffers->sharedContextVAO;
+}
+
 //--------------------------------------------------------------------------------------------------
 
-Model::Model(const std::vector<Mesh> &meshes) : tools::Model(""), meshes(meshes) {}
+Model::Model(const std::vector<Mesh> &meshes) : tools::Model(""), meshes(meshes) {
+    updateBounds();
+}
 
 Model::Model(const std::string &filePath) : tools::Model(filePath) {
     load(filePath);
 }
 
+Model::Model(const std::string &filePath, Data &&data) : tools::Model(filePath) {
+    upload(filePath, data);
+}
+
 void Model::draw(const Eigen::Vector3d &position, const Eigen::QuaternionD &orientation, const Eigen::Vector3d &scale,
                  const std::optional<Eigen::Vector3d> &color, const double &alpha) const {
     Shaders::activeShader->activate();
@@ -131,6 +206,20 @@ void Model::draw(const Eigen::Vector3d &position, const Eigen::QuaternionD &orie
     tools::Model::draw(position, orientation, scale, color, alpha);
 }
 
+void Model::drawProxy(const Eigen::Vector3d &position, const Eigen::QuaternionD &orientation, const Eigen::Vector3d &scale,
+                      const std::optional<Eigen::Vector3d> &color, const double &alpha) const {
+    //Fall back to the full meshes if no proxy was generated
+    if (proxyMeshes.empty()) {
+        draw(position, orientation, scale, color, alpha);
+        return;
+    }
+    Shaders::activeShader->activate();
+    Shaders::activeShader->setMat4("modelPose", utils::getGLMTransform(position, orientation, scale));
+    Shaders::activeShader->setFloat("objectAlpha", (float)alpha);
+    for (const Mesh &mesh : proxyMeshes)
+        mesh.draw(color);
+}
+
 std::optional<Model::HitInfo> Model::hitByRay(const Eigen::Vector3d &position, const Eigen::QuaternionD &orientation, const Eigen::Vector3d &scale,
                                               const Ray &ray) const {
     const glm::vec3 orig = utils::toGLM(ray.origin);
@@ -184,35 +273,69 @@ std::optional<Model::HitInfo> Model::hitByRay(const Eigen::Vector3d &position, c
     return std::nullopt;
 }
 
-inline uint loadTextureFromFile(const std::string &fileName, const std::string &directory) {
-    const std::string filePath = directory + '/' + fileName;
+Model::BoundingSphere Model::getBoundingSphere(const Eigen::Vector3d &position, const Eigen::QuaternionD &orientation, const Eigen::Vector3d &scale) const {
+    //Transform the center, non-uniform scaling is covered by the largest scale factor
+    const glm::vec4 center = utils::getGLMTransform(position, orientation, scale) * glm::vec4(bounds.center, 1);
+    return {glm::vec3(center), bounds.radius * (float)scale.cwiseAbs().maxCoeff()};
+}
 
-    uint textureID;
-    glGenTextures(1, &textureID);
+void Model::updateBounds() {
+    //Center of the axis-aligned bounding box
+    glm::vec3 minimum(HUGE_VALF), maximum(-HUGE_VALF);
+    for (const Mesh &mesh : meshes) {
+        for (const Mesh::Vertex &vertex : mesh.getVertices()) {
+            minimum = glm::min(minimum, vertex.position);
+            maximum = glm::max(maximum, vertex.position);
+        }
+    }
+    if (minimum.x > maximum.x) {
+        bounds = BoundingSphere();
+        return;
+    }
+    bounds.center = 0.5f * (minimum + maximum);
+
+    //Smallest radius around this center that contains all vertices
+    float radius2 = 0.f;
+    for (const Mesh &mesh : meshes)
+        for (const Mesh::Vertex &vertex : mesh.getVertices())
+            radius2 = std::max(radius2, glm::dot(vertex.position - bounds.center, vertex.position - bounds.center));
+    bounds.radius = std::sqrt(radius2);
+}
 
+inline std::string getDirectory(const std::string &filePath) {
+    std::string tmpPath(filePath);
+    std::replace(tmpPath.begin(), tmpPath.end(), '\\', '/');
+    return tmpPath.substr(0, tmpPath.find_last_of('/'));
+}
+
+inline std::optional<Model::Data::Texture> decodeTexture(const std::string &filePath) {
     int width, height, nrComponents;
     unsigned char *data = stbi_load(filePath.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format = 0;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    } else {
+    if (!data) {
         LENNY_LOG_WARNING("Failed to load texture from path `%s`", filePath.c_str());
+        return std::nullopt;
     }
+    Model::Data::Texture texture{width, height, nrComponents, std::vector<unsigned char>(data, data + (size_t)width * height * nrComponents)};
     stbi_image_free(data);
+    return texture;
+}
+
+inline uint uploadTexture(const Model::Data::Texture &texture) {
+    //Immutable storage for the full mip chain, the base level is streamed through a pixel buffer and the rest is generated on the GPU
+    static const GLenum formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    static const GLenum internalFormats[4] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    const int c = std::clamp(texture.numComponents, 1, 4) - 1;
+    const uint textureID = TextureUploader::createTexture(GL_TEXTURE_2D, internalFormats[c], texture.width, texture.height,
+                                                          TextureUploader::getNumLevels(texture.width, texture.height));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  //Rows of decoded images are tightly packed
+    TextureUploader::upload(GL_TEXTURE_2D, 0, texture.width, texture.height, formats[c], GL_UNSIGNED_BYTE, texture.pixels.data(), texture.pixels.size());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     return textureID;
 }
@@ -237,62 +360,118 @@ inline uint prepareImporter(const std::string &filePath) {
     return loadFlags;
 }
 
-void Model::load(const std::string &filePath) {
+inline size_t simplifyMeshData(std::vector<glm::vec3> &positions, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &texCoords, std::vector<uint> &indices,
+                               const float &threshold, const float &targetError, float &simplificationError) {
+    meshopt_Stream streams[] = {
+        {positions.data(), sizeof(glm::vec3), sizeof(glm::vec3)},
+        {normals.data(), sizeof(glm::vec3), sizeof(glm::vec3)},
+        {texCoords.data(), sizeof(glm::vec2), sizeof(glm::vec2)},
+    };
+
+    //--> Indexing
+    std::vector<uint> remap(indices.size());
+    size_t vertexCount =
+        meshopt_generateVertexRemapMulti(remap.data(), indices.data(), indices.size(), positions.size(), streams, sizeof(streams) / sizeof(streams[0]));
+
+    meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+    meshopt_remapVertexBuffer(positions.data(), positions.data(), positions.size(), sizeof(glm::vec3), remap.data());
+    meshopt_remapVertexBuffer(normals.data(), normals.data(), normals.size(), sizeof(glm::vec3), remap.data());
+    meshopt_remapVertexBuffer(texCoords.data(), texCoords.data(), texCoords.size(), sizeof(glm::vec2), remap.data());
+
+    //--> Simplification
+    const size_t targetIndexCount = size_t((float)indices.size() * threshold);
+    indices.resize(meshopt_simplify(&indices[0], indices.data(), indices.size(), &positions[0].x, vertexCount, sizeof(glm::vec3), targetIndexCount,
+                                    targetError, 0, &simplificationError));
+
+    //--> Vertex cache optimization
+    meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount);
+
+    //--> Overdraw optimization
+    meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(), &positions[0].x, vertexCount, sizeof(glm::vec3), 1.05f);
+
+    //---> Vertex fetch optimization
+    remap.clear();
+    remap.resize(vertexCount);
+    vertexCount = meshopt_optimizeVertexFetchRemap(remap.data(), indices.data(), indices.size(), vertexCount);
+
+    meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+    meshopt_remapVertexBuffer(positions.data(), positions.data(), positions.size(), sizeof(glm::vec3), remap.data());
+    meshopt_remapVertexBuffer(normals.data(), normals.data(), normals.size(), sizeof(glm::vec3), remap.data());
+    meshopt_remapVertexBuffer(texCoords.data(), texCoords.data(), texCoords.size(), sizeof(glm::vec2), remap.data());
+
+    //Drop the unused vertices
+    positions.resize(vertexCount);
+    normals.resize(vertexCount);
+    texCoords.resize(vertexCount);
+    return vertexCount;
+}
+
+class ImportProgressHandler : public Assimp::ProgressHandler {
+public:
+    ImportProgressHandler(const Model::F_progress &f_progress) : f_progress(f_progress) {}
+
+    //Reading and post-processing, half each
+    bool Update(float percentage) override {
+        if (percentage >= 0.f)
+            f_progress(percentage);
+        return true;
+    }
+
+private:
+    const Model::F_progress &f_progress;
+};
+
+inline void importMeshes(const std::string &filePath, const uint &loadFlags, std::vector<MeshContainer::Mesh> &meshes,
+                         std::vector<MeshContainer::Material> &materials, const Model::F_progress &f_progress) {
     //--- Import
-    const uint loadFlags = prepareImporter(filePath);
     Assimp::Importer importer;
+    if (f_progress)
+        importer.SetProgressHandler(new ImportProgressHandler(f_progress));  //Owned by the importer
     const aiScene *pScene = importer.ReadFile(filePath.c_str(), loadFlags);
     if (!pScene)
         LENNY_LOG_ERROR("Error in parsing file `%s`: `%s`", filePath.c_str(), importer.GetErrorString());
 
-    //--- Extract directory from filePath
-    std::string tmpPath(filePath);
-    std::replace(tmpPath.begin(), tmpPath.end(), '\\', '/');
-    const std::string directory = tmpPath.substr(0, tmpPath.find_last_of('/'));
-
     //--- Materials
-    std::vector<Mesh::Material> materials;
     for (uint i = 0; i < pScene->mNumMaterials; i++) {
         const aiMaterial *pMaterial = pScene->mMaterials[i];
 
-        Mesh::Material material;
+        MeshContainer::Material material;
         aiColor3D aiC;
 
         //Ambient color
         if (pMaterial->Get(AI_MATKEY_COLOR_AMBIENT, aiC) == AI_SUCCESS)
-            material.ambient = {aiC.r, aiC.g, aiC.b};
+            material.colors.ambient = {aiC.r, aiC.g, aiC.b};
         else
             LENNY_LOG_DEBUG("Ambient material color could not be read");
 
         //Diffuse color
         if (pMaterial->Get(AI_MATKEY_COLOR_DIFFUSE, aiC) == AI_SUCCESS)
-            material.diffuse = {aiC.r, aiC.g, aiC.b};
+            material.colors.diffuse = {aiC.r, aiC.g, aiC.b};
         else
             LENNY_LOG_DEBUG("Diffuse material color could not be read");
 
         //Specular color
         if (pMaterial->Get(AI_MATKEY_COLOR_SPECULAR, aiC) == AI_SUCCESS)
-            material.specular = {aiC.r, aiC.g, aiC.b};
+            material.colors.specular = {aiC.r, aiC.g, aiC.b};
         else
             LENNY_LOG_DEBUG("Specular material color could not be read");
 
-        //Texture
+        //Texture (loaded by the model, the name is all that is cached)
         if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
             aiString pPath;
             if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &pPath, nullptr, nullptr, nullptr, nullptr, nullptr) == AI_SUCCESS)
-                material.texture_diffuse = loadTextureFromFile(std::string(pPath.data), directory);
+                material.textureName = std::string(pPath.data);
         }
 
         materials.emplace_back(material);
     }
 
     //--- Meshes
-    this->meshes.clear();
     for (uint i = 0; i < pScene->mNumMeshes; i++) {
         const aiMesh *paiMesh = pScene->mMeshes[i];
+        MeshContainer::Mesh mesh;
 
         //Vertices
-        std::vector<Mesh::Vertex> vertices;
         for (uint j = 0; j < paiMesh->mNumVertices; j++) {
             const aiVector3D &pPos = paiMesh->mVertices[j];
 
@@ -306,32 +485,129 @@ void Model::load(const std::string &filePath) {
             if (paiMesh->HasTextureCoords(0))
                 tCoo = paiMesh->mTextureCoords[0][j];
 
-            vertices.push_back({glm::vec3(pPos.x, pPos.y, pPos.z), glm::vec3(pNor.x, pNor.y, pNor.z), glm::vec2(tCoo.x, tCoo.y)});
+            mesh.vertices.push_back({glm::vec3(pPos.x, pPos.y, pPos.z), glm::vec3(pNor.x, pNor.y, pNor.z), glm::vec2(tCoo.x, tCoo.y)});
         }
 
         //Indices
-        std::vector<uint> indices;
         for (uint j = 0; j < paiMesh->mNumFaces; j++) {
             const aiFace &face = paiMesh->mFaces[j];
 
             if (face.mNumIndices == 3)
                 for (uint k = 0; k < 3; k++)
-                    indices.push_back(face.mIndices[k]);
+                    mesh.indices.push_back(face.mIndices[k]);
             else
                 LENNY_LOG_DEBUG("(Model `%s`): Number of indices should be 3, but instead is %d... We just ignore these indices", filePath.c_str(),
                                 face.mNumIndices);
         }
 
         //Add to meshes
-        if (vertices.size() > 0 && indices.size() > 0) {
+        if (mesh.vertices.size() > 0 && mesh.indices.size() > 0) {
             if (paiMesh->mMaterialIndex < materials.size())
-                this->meshes.emplace_back(vertices, indices, materials[paiMesh->mMaterialIndex]);
-            else
-                this->meshes.emplace_back(vertices, indices);
+                mesh.materialIndex = (int)paiMesh->mMaterialIndex;
+            meshes.emplace_back(std::move(mesh));
         }
     }
 }
 
+void Model::load(const std::string &filePath) {
+    Data data = loadData(filePath);
+    upload(filePath, data);
+}
+
+Model::Data Model::loadData(const std::string &filePath, const F_progress &f_progress) {
+    //--- Progress, the import takes most of the time and the textures the rest
+    const auto reportProgress = [&](float progress) -> void {
+        if (f_progress)
+            f_progress(progress);
+    };
+    const F_progress f_importProgress = [&](float progress) -> void { reportProgress(0.8f * progress); };
+
+    //--- Nothing to load if the meshes of this file are in use
+    Data data;
+    if (AssetRegistry::hasMeshes(filePath)) {
+        data.isShared = true;
+        reportProgress(1.f);
+        return data;
+    }
+
+    //--- Map the processed meshes of an earlier import, the file is only imported (and cached) if its contents or the import flags changed
+    const uint loadFlags = prepareImporter(filePath);
+    const uint64_t key = MeshContainer::getKey(filePath, loadFlags);
+    const std::string containerPath = MeshContainer::getFilePath(key);
+    data.container = std::make_shared<MeshContainer>();
+    if (data.container->open(containerPath, key)) {
+        for (int i = 0; i < data.container->getNumMaterials(); i++)
+            data.materials.emplace_back(data.container->getMaterial(i));
+    } else {
+        data.container = nullptr;
+        importMeshes(filePath, loadFlags, data.meshes, data.materials, f_importProgress);
+        if (!MeshContainer::write(containerPath, key, data.meshes, data.materials))
+            LENNY_LOG_WARNING("Could not cache the meshes of `%s`", filePath.c_str())
+    }
+    reportProgress(0.8f);
+
+    //--- Textures except the ones in use, one after the other since the loader already runs a file on each core
+    const std::string directory = getDirectory(filePath);
+    data.textures.resize(data.materials.size());
+    for (size_t i = 0; i < data.materials.size(); i++) {
+        const MeshContainer::Material &material = data.materials[i];
+        const std::string texturePath = directory + '/' + material.textureName;
+        if (!material.textureName.empty() && !AssetRegistry::hasTexture(texturePath))
+            data.textures[i] = decodeTexture(texturePath);
+        reportProgress(0.8f + 0.2f * (float)(i + 1) / (float)data.materials.size());
+    }
+    reportProgress(1.f);
+    return data;
+}
+
+void Model::upload(const std::string &filePath, Data &data) {
+    //--- Share the meshes of another model of this file, they are only loaded again if it was deleted since loading skipped them
+    this->proxyMeshes.clear();
+    sharedMeshes = AssetRegistry::findMeshes(filePath);
+    if (sharedMeshes) {
+        this->meshes = *sharedMeshes;
+        updateBounds();
+        return;
+    }
+    if (data.isShared)
+        data = loadData(filePath);
+
+    //--- Materials, with the textures of other models where they are in use
+    const std::string directory = getDirectory(filePath);
+    std::vector<Mesh::Material> meshMaterials;
+    for (size_t i = 0; i < data.materials.size(); i++) {
+        meshMaterials.emplace_back(data.materials[i].colors);
+        if (data.materials[i].textureName.empty())
+            continue;
+        const std::string texturePath = directory + '/' + data.materials[i].textureName;
+        meshMaterials.back().texture_diffuse = AssetRegistry::findTexture(texturePath);
+        if (!meshMaterials.back().texture_diffuse && !data.textures[i].has_value())
+            data.textures[i] = decodeTexture(texturePath);  //Skipped while loading, but deleted since
+        if (!meshMaterials.back().texture_diffuse && data.textures[i].has_value())
+            meshMaterials.back().texture_diffuse = AssetRegistry::addTexture(texturePath, uploadTexture(data.textures[i].value()));
+    }
+
+    //--- Meshes, uploaded straight from the mapping on a cache hit
+    std::vector<Mesh> loadedMeshes;
+    const auto addMesh = [&](const Mesh::Vertex *vertices, uint numVertices, const uint *indices, uint numIndices, int materialIndex) -> void {
+        if (materialIndex >= 0)
+            loadedMeshes.emplace_back(vertices, numVertices, indices, numIndices, meshMaterials[materialIndex]);
+        else
+            loadedMeshes.emplace_back(vertices, numVertices, indices, numIndices, std::nullopt);
+    };
+    if (data.container) {
+        for (int i = 0; i < data.container->getNumMeshes(); i++)
+            addMesh(data.container->getVertices(i), data.container->getNumVertices(i), data.container->getIndices(i), data.container->getNumIndices(i),
+                    data.container->getMaterialIndex(i));
+    } else {
+        for (const MeshContainer::Mesh &mesh : data.meshes)
+            addMesh(mesh.vertices.data(), (uint)mesh.vertices.size(), mesh.indices.data(), (uint)mesh.indices.size(), mesh.materialIndex);
+    }
+    sharedMeshes = AssetRegistry::addMeshes(filePath, std::move(loadedMeshes));
+    this->meshes = *sharedMeshes;
+    updateBounds();
+}
+
 bool Model::exportAsOBJ() const {
     //--- Import
     const uint loadFlags = prepareImporter(filePath);
@@ -380,11 +656,6 @@ void Model::simplify(const float &threshold, const float &targetError, const boo
             texCoords.push_back(glm::vec2(tCoo.x, tCoo.y));
         }
         const int originalVertexCount = positions.size();
-        meshopt_Stream streams[] = {
-            {positions.data(), sizeof(glm::vec3), sizeof(glm::vec3)},
-            {normals.data(), sizeof(glm::vec3), sizeof(glm::vec3)},
-            {texCoords.data(), sizeof(glm::vec2), sizeof(glm::vec2)},
-        };
 
         //Get indices
         std::vector<uint> indices;
@@ -396,37 +667,9 @@ void Model::simplify(const float &threshold, const float &targetError, const boo
         }
         const int originalIndexCount = indices.size();
 
-        //--> Indexing
-        std::vector<uint> remap(indices.size());
-        size_t vertexCount =
-            meshopt_generateVertexRemapMulti(remap.data(), indices.data(), indices.size(), positions.size(), streams, sizeof(streams) / sizeof(streams[0]));
-
-        meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
-        meshopt_remapVertexBuffer(positions.data(), positions.data(), positions.size(), sizeof(glm::vec3), remap.data());
-        meshopt_remapVertexBuffer(normals.data(), normals.data(), normals.size(), sizeof(glm::vec3), remap.data());
-        meshopt_remapVertexBuffer(texCoords.data(), texCoords.data(), texCoords.size(), sizeof(glm::vec2), remap.data());
-
-        //--> Simplification
-        const size_t targetIndexCount = size_t((float)indices.size() * threshold);
+        //Simplify
         float simplificationError = 0.f;
-        indices.resize(meshopt_simplify(&indices[0], indices.data(), indices.size(), &positions[0].x, vertexCount, sizeof(glm::vec3), targetIndexCount,
-                                        targetError, 0, &simplificationError));
-
-        //--> Vertex cache optimization
-        meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount);
-
-        //--> Overdraw optimization
-        meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(), &positions[0].x, vertexCount, sizeof(glm::vec3), 1.05f);
-
-        //---> Vertex fetch optimization
-        remap.clear();
-        remap.resize(vertexCount);
-        vertexCount = meshopt_optimizeVertexFetchRemap(remap.data(), indices.data(), indices.size(), vertexCount);
-
-        meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
-        meshopt_remapVertexBuffer(positions.data(), positions.data(), positions.size(), sizeof(glm::vec3), remap.data());
-        meshopt_remapVertexBuffer(normals.data(), normals.data(), normals.size(), sizeof(glm::vec3), remap.data());
-        meshopt_remapVertexBuffer(texCoords.data(), texCoords.data(), texCoords.size(), sizeof(glm::vec2), remap.data());
+        const size_t vertexCount = simplifyMeshData(positions, normals, texCoords, indices, threshold, targetError, simplificationError);
 
         //Debug output
         LENNY_LOG_DEBUG("MESH SIMPLIFICATION: Index count: (%d VS %d). Vertex count: (%d VS %d). Result error: %lf", indices.size(), originalIndexCount,
@@ -471,6 +714,9 @@ void Model::simplify(const float &threshold, const float &targetError, const boo
         }
     }
 
+    updateBounds();
+    proxyMeshes.clear();  //Generated from the previous meshes
+
     //--- Export
     if (saveToFile) {
         const std::size_t found = filePath.find_last_of(".");
@@ -484,4 +730,34 @@ void Model::simplify(const float &threshold, const float &targetError, const boo
     }
 }
 
+void Model::generateProxy(const float &threshold, const float &targetError) {
+    //Simplify copies of the loaded meshes, the originals stay untouched
+    proxyMeshes.clear();
+    for (const Mesh &mesh : meshes) {
+        std::vector<glm::vec3> positions, normals;
+        std::vector<glm::vec2> texCoords;
+        for (const Mesh::Vertex &vertex : mesh.getVertices()) {
+            positions.push_back(vertex.position);
+            normals.push_back(vertex.normal);
+            texCoords.push_back(vertex.texCoords);
+        }
+        std::vector<uint> indices = mesh.getIndices();
+        if (positions.empty() || indices.empty())
+            continue;
+
+        float simplificationError = 0.f;
+        const size_t vertexCount = simplifyMeshData(positions, normals, texCoords, indices, threshold, targetError, simplificationError);
+        LENNY_LOG_DEBUG("PROXY MESH: Index count: (%zu VS %zu). Vertex count: (%zu VS %zu). Result error: %lf", indices.size(), mesh.getIndices().size(),
+                        vertexCount, mesh.getVertices().size(), simplificationError);
+
+        std::vector<Mesh::Vertex> vertices;
+        for (size_t j = 0; j < vertexCount; j++)
+            vertices.push_back({positions.at(j), normals.at(j), texCoords.at(j)});
+        if (mesh.getMaterial().has_value())
+            proxyMeshes.emplace_back(vertices, indices, mesh.getMaterial().value());
+        else
+            proxyMeshes.emplace_back(vertices, indices);
+    }
+}
+
 }  // namespace lenny::gui
\ No newline at end of file
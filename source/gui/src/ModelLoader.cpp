@@ -0,0 +1,89 @@
+#include <lenny/gui/ModelLoader.h>
+
+#include <algorithm>
+
+namespace lenny::gui {
+
+ModelLoader::ModelLoader(int numThreads) : numThreads(numThreads > 0 ? numThreads : std::max(1, (int)std::thread::hardware_concurrency())) {}
+
+ModelLoader::~ModelLoader() {
+    {
+        std::scoped_lock lock(mutex);
+        isStopping = true;
+        jobs.clear();
+    }
+    jobAdded.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+uint64_t ModelLoader::request(const std::string& filePath) {
+    std::scoped_lock lock(mutex);
+    if (threads.empty())
+        for (int i = 0; i < numThreads; i++)
+            threads.emplace_back(&ModelLoader::run, this);
+    const uint64_t ticket = nextTicket++;
+    jobs.emplace_back(ticket, filePath);
+    unfinishedTickets[ticket] = 0.f;
+    jobAdded.notify_one();
+    return ticket;
+}
+
+std::optional<ModelLoader::Result> ModelLoader::poll() {
+    std::scoped_lock lock(mutex);
+    if (results.empty())
+        return std::nullopt;
+    Result result = std::move(results.front());
+    results.pop_front();
+    return result;
+}
+
+std::optional<ModelLoader::Result> ModelLoader::wait(uint64_t ticket) {
+    std::unique_lock lock(mutex);
+    jobFinished.wait(lock, [&]() -> bool { return !unfinishedTickets.contains(ticket); });
+    const auto it = std::find_if(results.begin(), results.end(), [&](const Result& result) -> bool { return result.ticket == ticket; });
+    if (it == results.end())
+        return std::nullopt;
+    Result result = std::move(*it);
+    results.erase(it);
+    return result;
+}
+
+int ModelLoader::getNumUnfinished() const {
+    std::scoped_lock lock(mutex);
+    return (int)unfinishedTickets.size();
+}
+
+float ModelLoader::getProgress(uint64_t ticket) const {
+    std::scoped_lock lock(mutex);
+    const auto it = unfinishedTickets.find(ticket);
+    return it != unfinishedTickets.end() ? it->second : 1.f;
+}
+
+void ModelLoader::run() {
+    while (true) {
+        std::pair<uint64_t, std::string> job;
+        {
+            std::unique_lock lock(mutex);
+            jobAdded.wait(lock, [&]() -> bool { return isStopping || !jobs.empty(); });
+            if (isStopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        //Files are independent, only the queues are shared
+        Model::Data data = Model::loadData(job.second, [&](float progress) -> void {
+            std::scoped_lock lock(mutex);
+            unfinishedTickets[job.first] = progress;
+        });
+        {
+            std::scoped_lock lock(mutex);
+            results.push_back({job.first, std::move(job.second), std::move(data)});
+            unfinishedTickets.erase(job.first);
+        }
+        jobFinished.notify_all();
+    }
+}
+
+}  // namespace lenny::gui
@@ -69,7 +69,8 @@ void Scene::draw() {
     //Update camera parameters
     camera.setAspectRatio(size.x / size.y);
 
-    //Update shader
+    //Update shader (and compile a variant that was selected in a previous frame)
+    Shaders::compileNextVariant();
     Shaders::update(camera, light);
 
     //Prepare frame buffer
@@ -193,6 +194,22 @@ void Scene::sync(const Scene::CSPtr otherScene) {
 }
 
 bool Scene::saveScreenshotToFile(const std::string& filePath) const {
+    //Get image
+    std::vector<unsigned char> pixels;
+    int width, height;
+    readScreenshot(pixels, width, height);
+
+    //Save image to file
+    stbi_flip_vertically_on_write(true);
+    const bool successful = stbi_write_png(filePath.c_str(), width, height, 3, pixels.data(), 3 * width);
+    if (successful)
+        LENNY_LOG_INFO("Successfully saved screenshot to file `%s`", filePath.c_str())
+    else
+        LENNY_LOG_WARNING("Could not save screenshot into file `%s`", filePath.c_str())
+    return successful;
+}
+
+void Scene::readScreenshot(std::vector<unsigned char>& pixels, int& width, int& height) const {
     //Bind frame buffer
     glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
     const GLsizei nrChannels = 3;
@@ -206,24 +223,14 @@ bool Scene::saveScreenshotToFile(const std::string& filePath) const {
     glReadBuffer(GL_FRONT);
     glReadPixels(0, 0, textureWidth, textureHeight, GL_RGB, GL_UNSIGNED_BYTE, buffer_input.data());
 
-    //Resize image
-    GLsizei stride_output = nrChannels * windowSize[0];
-    stride_output += (stride_output % 4) ? (4 - stride_output % 4) : 0;
-    GLsizei bufferSize_output = stride_output * windowSize[1];
-    std::vector<unsigned char> buffer_output(bufferSize_output);
-    stbir_resize_uint8(buffer_input.data(), textureWidth, textureHeight, stride_input, buffer_output.data(), windowSize[0], windowSize[1], stride_output, nrChannels);
-
-    //Save image to file
-    stbi_flip_vertically_on_write(true);
-    const bool successful = stbi_write_png(filePath.c_str(), windowSize[0], windowSize[1], nrChannels, buffer_output.data(), stride_output);
-    if (successful)
-        LENNY_LOG_INFO("Successfully saved screenshot to file `%s`", filePath.c_str())
-    else
-        LENNY_LOG_WARNING("Could not save screenshot into file `%s`", filePath.c_str())
+    //Resize image to the window, without padding between the rows
+    width = (int)windowSize[0];
+    height = (int)windowSize[1];
+    pixels.resize((size_t)nrChannels * width * height);
+    stbir_resize_uint8(buffer_input.data(), textureWidth, textureHeight, stride_input, pixels.data(), width, height, nrChannels * width, nrChannels);
 
     //Deactivate frame buffer
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    return successful;
 }
 
 }  // namespace lenny::gui
\ No newline at end of file
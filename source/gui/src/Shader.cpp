@@ -2,79 +2,210 @@
 #include <lenny/gui/Shader.h>
 #include <lenny/tools/Logger.h>
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <vector>
 
 namespace lenny::gui {
 
-Shader::Shader(const std::string &vertexPath, const std::string &fragmentPath) {
-    load(vertexPath, fragmentPath);
+Shader::Shader(const std::string &vertexPath, const std::string &fragmentPath, const std::string &geometryPath, const std::vector<Permutation> &permutations)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath), permutations(permutations), permutationValues(permutations.size(), -1) {
+    ID = currentID = load("");
+    variants[GENERIC] = {ID, 0};
 }
 
 void Shader::activate() const {
-    glUseProgram(ID);
+    glUseProgram(currentID);
+}
+
+void Shader::release() {
+    for (const auto &[key, variant] : variants)
+        glDeleteProgram(variant.ID);
+    variants.clear();
+    missingKeys.clear();
+    ID = currentID = 0;
+    currentKey = GENERIC;
+}
+
+void Shader::selectProgram() const {
+    //Mixed-radix key of the permutation values, the generic program if disabled or a value has no variant
+    uint32_t key = (usePermutations && !permutations.empty()) ? 0 : GENERIC;
+    for (size_t i = 0; i < permutations.size() && key != GENERIC; i++) {
+        if (permutationValues[i] < 0 || permutationValues[i] >= permutations[i].numValues)
+            key = GENERIC;
+        else
+            key = key * permutations[i].numValues + permutationValues[i];
+    }
+    if (key == currentKey)
+        return;
+
+    //Compiling would stall the draw, so a new variant is drawn with the generic program until compileNextVariant is called
+    auto variant = variants.find(key);
+    if (variant == variants.end()) {
+        if (std::find(missingKeys.begin(), missingKeys.end(), key) == missingKeys.end())
+            missingKeys.emplace_back(key);
+        key = GENERIC;
+        if (key == currentKey)
+            return;
+        variant = variants.find(key);
+    }
+
+    //Everything set so far reached the program we leave
+    variants[currentKey].version = version;
+
+    //Switch and catch up with the uniforms set since it was used last
+    glUseProgram(variant->second.ID);
+    for (const auto &[name, uniform] : uniforms)
+        if (uniform.version > variant->second.version)
+            apply(variant->second, name, uniform);
+    currentKey = key;
+    currentID = variant->second.ID;
+}
+
+bool Shader::compileNextVariant() {
+    if (missingKeys.empty())
+        return false;
+    const uint32_t key = missingKeys.front();
+    missingKeys.erase(missingKeys.begin());
+
+    //Decode the permutation values of the mixed-radix key, the last permutation is the least significant digit
+    std::string defines;
+    uint32_t remainder = key;
+    for (size_t i = permutations.size(); i-- > 0;) {
+        defines += "#define STATIC_" + permutations[i].name + " " + std::to_string(remainder % permutations[i].numValues) + "\n";
+        remainder /= permutations[i].numValues;
+    }
+
+    //The uniforms are replayed when the variant is selected
+    variants.emplace(key, Variant{load(defines), 0});
+    return true;
 }
 
 void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    set(name, {Uniform::INT, {}, (int)value, 0});
 }
 
 void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    set(name, {Uniform::INT, {}, value, 0});
 }
 
 void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    set(name, {Uniform::FLOAT, {value}, 0, 0});
 }
 
 void Shader::setVec2(const std::string &name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(name, {Uniform::VEC2, {value.x, value.y}, 0, 0});
 }
 void Shader::setVec2(const std::string &name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    set(name, {Uniform::VEC2, {x, y}, 0, 0});
 }
 
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(name, {Uniform::VEC3, {value.x, value.y, value.z}, 0, 0});
 }
 void Shader::setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    set(name, {Uniform::VEC3, {x, y, z}, 0, 0});
 }
 
 void Shader::setVec4(const std::string &name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    set(name, {Uniform::VEC4, {value.x, value.y, value.z, value.w}, 0, 0});
 }
 void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    set(name, {Uniform::VEC4, {x, y, z, w}, 0, 0});
 }
 
 void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    Uniform uniform = {Uniform::MAT2, {}, 0, 0};
+    std::copy(&mat[0][0], &mat[0][0] + 4, uniform.values.begin());
+    set(name, uniform);
 }
 
 void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    Uniform uniform = {Uniform::MAT3, {}, 0, 0};
+    std::copy(&mat[0][0], &mat[0][0] + 9, uniform.values.begin());
+    set(name, uniform);
 }
 
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    Uniform uniform = {Uniform::MAT4, {}, 0, 0};
+    std::copy(&mat[0][0], &mat[0][0] + 16, uniform.values.begin());
+    set(name, uniform);
 }
 
 unsigned int Shader::getID() const {
-    return ID;
+    return currentID;
+}
+
+int Shader::getNumVariants() const {
+    return (int)variants.size() - 1;
+}
+
+void Shader::set(const std::string &name, const Uniform &uniform) const {
+    //Permutation values select the variant on the next draw
+    if (uniform.type == Uniform::INT)
+        for (size_t i = 0; i < permutations.size(); i++)
+            if (permutations[i].name == name)
+                permutationValues[i] = uniform.intValue;
+
+    //Record the value for the other programs and set it on the one in use
+    Uniform &stored = uniforms[name];
+    stored = uniform;
+    stored.version = ++version;
+    apply(variants[currentKey], name, stored);
+}
+
+void Shader::apply(Variant &variant, const std::string &name, const Uniform &uniform) const {
+    //Uniforms compiled out of a variant have no location and are ignored
+    auto location = variant.locations.find(name);
+    if (location == variant.locations.end())
+        location = variant.locations.emplace(name, glGetUniformLocation(variant.ID, name.c_str())).first;
+    apply(location->second, uniform);
+}
+
+void Shader::apply(int location, const Uniform &uniform) const {
+    const float *values = uniform.values.data();
+    switch (uniform.type) {
+        case Uniform::INT:
+            glUniform1i(location, uniform.intValue);
+            break;
+        case Uniform::FLOAT:
+            glUniform1f(location, values[0]);
+            break;
+        case Uniform::VEC2:
+            glUniform2fv(location, 1, values);
+            break;
+        case Uniform::VEC3:
+            glUniform3fv(location, 1, values);
+            break;
+        case Uniform::VEC4:
+            glUniform4fv(location, 1, values);
+            break;
+        case Uniform::MAT2:
+            glUniformMatrix2fv(location, 1, GL_FALSE, values);
+            break;
+        case Uniform::MAT3:
+            glUniformMatrix3fv(location, 1, GL_FALSE, values);
+            break;
+        case Uniform::MAT4:
+            glUniformMatrix4fv(location, 1, GL_FALSE, values);
+            break;
+    }
 }
 
-void Shader::load(const std::string &vertexPath, const std::string &fragmentPath) {
-    //--- Retrieve the vertex/fragment source code from the individual files
-    std::string vertexCode, fragmentCode;
+unsigned int Shader::load(const std::string &defines) const {
+    //--- Retrieve the vertex/fragment/geometry source code from the individual files (the defines only specialize the fragment shader)
+    std::string vertexCode, fragmentCode, geometryCode;
     getCodeFromFile(vertexCode, vertexPath);
-    getCodeFromFile(fragmentCode, fragmentPath);
+    getCodeFromFile(fragmentCode, fragmentPath, defines);
+    if (!geometryPath.empty())
+        getCodeFromFile(geometryCode, geometryPath);
     const char *vCode = vertexCode.c_str();
     const char *fCode = fragmentCode.c_str();
+    const char *gCode = geometryCode.c_str();
 
     //--- Compile shaders
-    unsigned int vertex, fragment;
+    unsigned int vertex, fragment, geometry = 0;
 
     //Vertex shader
     vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -88,19 +219,32 @@ void Shader::load(const std::string &vertexPath, const std::string &fragmentPath
     glCompileShader(fragment);
     checkShaderCompilationErrors(fragment, "FRAGMENT");
 
+    //Geometry shader (optional)
+    if (!geometryPath.empty()) {
+        geometry = glCreateShader(GL_GEOMETRY_SHADER);
+        glShaderSource(geometry, 1, &gCode, nullptr);
+        glCompileShader(geometry);
+        checkShaderCompilationErrors(geometry, "GEOMETRY");
+    }
+
     //--- Link program
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkProgramCompilationErrors(ID);
+    const unsigned int program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    if (geometry)
+        glAttachShader(program, geometry);
+    glLinkProgram(program);
+    checkProgramCompilationErrors(program);
 
     // --- Delete shaders
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    if (geometry)
+        glDeleteShader(geometry);
+    return program;
 }
 
-void Shader::getCodeFromFile(std::string &code, const std::string &path) const {
+void Shader::getCodeFromFile(std::string &code, const std::string &path, const std::string &defines) const {
     //Implement split function
     auto split = [](std::vector<std::string> &v, const std::string &s, const char delim) -> void {
         v.clear();
@@ -133,6 +277,10 @@ void Shader::getCodeFromFile(std::string &code, const std::string &path) const {
             s.assign((std::istreambuf_iterator<char>(sourceFile)), std::istreambuf_iterator<char>());
         }
         stream << s << std::endl;
+
+        //Defines have to follow the version directive
+        if (token.size() >= 1 && token[0] == "#version")
+            stream << defines;
     }
 
     //Close file handlers
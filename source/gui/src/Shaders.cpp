@@ -2,30 +2,80 @@
 
 namespace lenny::gui {
 
-std::vector<Shader> Shaders::shaderList = {};
+thread_local std::vector<Shader> Shaders::shaderList = {};
 
-Shader* Shaders::activeShader = nullptr;
+thread_local Shader* Shaders::activeShader = nullptr;
 
 void Shaders::initialize() {
+    //Uniforms of shader.frag that select the branches of the ubershader
+    const std::vector<Shader::Permutation> permutations = {
+        {"isSkybox", 2}, {"useTexture", 2}, {"useMaterial", 2}, {"enableEnvironmentMapping", 2}, {"environmentMappingType", 4}};
+
+    shaderList.clear();
+    shaderList.emplace_back(LENNY_GUI_OPENGL_FOLDER "/data/shaders/shader.vert", LENNY_GUI_OPENGL_FOLDER "/data/shaders/shader.frag", "", permutations);
+    shaderList.emplace_back(LENNY_GUI_OPENGL_FOLDER "/data/shaders/cubemap.vert", LENNY_GUI_OPENGL_FOLDER "/data/shaders/shader.frag",
+                            LENNY_GUI_OPENGL_FOLDER "/data/shaders/cubemap.geom", permutations);
+    shaderList.emplace_back(LENNY_GUI_OPENGL_FOLDER "/data/shaders/cubemap.vert", LENNY_GUI_OPENGL_FOLDER "/data/shaders/shader.frag",
+                            LENNY_GUI_OPENGL_FOLDER "/data/shaders/paraboloid.geom", permutations);
+    shaderList.emplace_back(LENNY_GUI_OPENGL_FOLDER "/data/shaders/cubemap.vert", LENNY_GUI_OPENGL_FOLDER "/data/shaders/shader.frag",
+                            LENNY_GUI_OPENGL_FOLDER "/data/shaders/octahedral.geom", permutations);
+
+    //Samplers of different types must not share a texture unit
+    for (const Shader& shader : shaderList) {
+        shader.activate();
+        shader.setInt("texture_diffuse", 0);
+        shader.setInt("texture_cubemap", 1);
+        shader.setInt("texture_paraboloid", 2);
+        shader.setInt("texture_octahedral", 3);
+        for (int i = 0; i < 4; i++)
+            shader.setInt("texture_probes[" + std::to_string(i) + "]", 4 + i);
+    }
+
+    setActiveShader(BASIC);
+}
+
+std::vector<Shader> Shaders::detach() {
+    std::vector<Shader> shaders = std::move(shaderList);
     shaderList.clear();
-    shaderList.emplace_back(LENNY_GUI_OPENGL_FOLDER "/data/shaders/shader.vert", LENNY_GUI_OPENGL_FOLDER "/data/shaders/shader.frag");
+    activeShader = nullptr;
+    return shaders;
+}
 
+void Shaders::attach(std::vector<Shader>&& shaders) {
+    shaderList = std::move(shaders);
     setActiveShader(BASIC);
 }
 
+void Shaders::compileNextVariant() {
+    //One program per frame keeps the hitch of a new permutation short, the generic program draws it meanwhile
+    for (Shader& shader : shaderList)
+        if (shader.compileNextVariant())
+            return;
+}
+
 void Shaders::update(const Camera& camera, const Light& light) {
-    shaderList[BASIC].activate();
-
-    shaderList[BASIC].setMat4("cameraProjection", camera.getProjectionMatrix());
-    shaderList[BASIC].setMat4("cameraView", camera.getViewMatrix());
-    shaderList[BASIC].setVec3("cameraPosition", camera.getPosition());
-
-    shaderList[BASIC].setVec3("lightPosition", light.getPosition());
-    shaderList[BASIC].setVec3("lightColor", light.getColor());
-    shaderList[BASIC].setVec3("lightGlow", light.getGlow());
-    shaderList[BASIC].setFloat("strength.ambient", light.ambientStrength);
-    shaderList[BASIC].setFloat("strength.diffuse", light.diffuseStrength);
-    shaderList[BASIC].setFloat("strength.specular", light.specularStrength);
+    for (const Shader& shader : shaderList) {
+        shader.activate();
+
+        shader.setMat4("cameraProjection", camera.getProjectionMatrix());
+        shader.setMat4("cameraView", camera.getViewMatrix());
+        shader.setVec3("cameraPosition", camera.getPosition());
+    }
+    updateLight(light);
+}
+
+void Shaders::updateLight(const Light& light) {
+    for (const Shader& shader : shaderList) {
+        shader.activate();
+
+        shader.setVec3("lightPosition", light.getPosition());
+        shader.setVec3("lightColor", light.getColor());
+        shader.setVec3("lightGlow", light.getGlow());
+        shader.setFloat("strength.ambient", light.ambientStrength);
+        shader.setFloat("strength.diffuse", light.diffuseStrength);
+        shader.setFloat("strength.specular", light.specularStrength);
+    }
+    activeShader->activate();
 }
 
 void Shaders::setActiveShader(SHADERS shader) {
@@ -0,0 +1,51 @@
+#include <glad/glad.h>
+#include <lenny/gui/TextureUploader.h>
+#include <lenny/tools/Logger.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace lenny::gui {
+
+uint TextureUploader::createTexture(uint target, uint internalFormat, int width, int height, int numLevels) {
+    uint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    glTexStorage2D(target, numLevels, internalFormat, width, height);
+    return texture;
+}
+
+void TextureUploader::upload(uint target, int level, int width, int height, uint format, uint type, const void* pixels, size_t numBytes) {
+    //The buffer is created on the first upload, in the context of the thread uploading
+    if (buffer == 0)
+        glGenBuffers(1, &buffer);
+
+    //Stage the pixels in new storage of the buffer, the driver keeps the old one until its transfer is done
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)numBytes, nullptr, GL_STREAM_DRAW);
+    void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)numBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!staging) {
+        LENNY_LOG_WARNING("Could not map the pixel buffer, uploading directly")
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexSubImage2D(target, level, 0, 0, width, height, format, type, pixels);
+        return;
+    }
+    std::memcpy(staging, pixels, numBytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    //The data pointer is an offset into the bound buffer
+    glTexSubImage2D(target, level, 0, 0, width, height, format, type, nullptr);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+int TextureUploader::getNumLevels(int width, int height) {
+    return std::bit_width((unsigned)std::max(1, std::max(width, height)));
+}
+
+void TextureUploader::release() {
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+}  // namespace lenny::gui
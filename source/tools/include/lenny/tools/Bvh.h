@@ -0,0 +1,56 @@
+#pragma once
+
+#include <lenny/tools/Definitions.h>
+
+#include <optional>
+
+namespace lenny::tools {
+
+/**
+ * Bounding volume hierarchy over triangles, built with the binned surface area heuristic.
+ * Triangles are passed as three consecutive positions each, hits refer to their index in that list.
+ */
+class Bvh {
+public:
+    struct Hit {
+        int triangle;
+        float t;
+        float u, v;  //Barycentric coordinates of the second and third vertex
+    };
+
+    Bvh() = default;
+    ~Bvh() = default;
+
+    //--- Building
+    void build(const std::vector<Eigen::Vector3f>& positions);
+    int getNumTriangles() const;
+    int getNumNodes() const;
+
+    //--- Queries
+    std::optional<Hit> intersect(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction, float tMax) const;  //Closest hit
+    bool isOccluded(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction, float tMax) const;               //Any hit
+
+public:
+    int maxLeafSize = 4;
+    int numBins = 12;
+
+private:
+    static constexpr int MAX_DEPTH = 62;  //Bounds the traversal stack
+
+    struct Node {
+        Eigen::AlignedBox3f bounds;
+        int first;  //Index of the first triangle of a leaf, or of the left child (the right one follows it)
+        int count;  //Triangles of a leaf, 0 for inner nodes
+    };
+
+    void subdivide(int nodeIndex, const std::vector<Eigen::AlignedBox3f>& triangleBounds, const std::vector<Eigen::Vector3f>& centroids);
+    template <bool ANY_HIT>
+    std::optional<Hit> traverse(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction, float tMax) const;
+
+private:
+    std::vector<Node> nodes;
+    std::vector<int> triangleIndices;  //Ordered by leaf
+    std::vector<Eigen::Vector3f> positions;
+};
+
+}  // namespace lenny::tools
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <lenny/tools/Definitions.h>
+
+namespace lenny::tools {
+
+/**
+ * CPU cubemap with float RGBA texels and a mip chain.
+ * Faces follow the order and orientation of the OpenGL cubemap sides (+x, -x, +y, -y, +z, -z),
+ * each face is stored row by row with the first row at t = 0.
+ */
+class Cubemap {
+public:
+    typedef std::vector<Eigen::Array4f> Level;  //Texels of all faces, indexed by (face * size + y) * size + x
+
+    Cubemap() = default;
+    Cubemap(int size, int numLevels = 1);
+    ~Cubemap() = default;
+
+    //--- Access
+    int getSize(int level = 0) const;
+    int getNumLevels() const;
+    Eigen::Array4f* getFace(int level, int face);
+    const Eigen::Array4f* getFace(int level, int face) const;
+    void setFace(int face, const unsigned char* data, int numComponents);  //8-bit image of the base level size
+    Eigen::Array4f sample(const Eigen::Vector3f& direction, float level) const;
+
+    //--- Conversion
+    static Cubemap fromEquirectangular(const float* data, int width, int height, int numComponents, int size,
+                                       int numThreads = 0);  //Longitude 0 (the image center) looks along -z
+
+    //--- Directions
+    static Eigen::Vector3f getDirection(int face, float s, float t);
+    static int getFaceCoordinates(const Eigen::Vector3f& direction, float& s, float& t);
+
+    //--- Filtering
+    void generateMipmaps();
+    Cubemap prefilterGGX(int numLevels, int numSamples, int numThreads = 0) const;
+
+public:
+    std::vector<Level> levels;
+
+private:
+    int size = 0;  //Of the base level
+};
+
+}  // namespace lenny::tools
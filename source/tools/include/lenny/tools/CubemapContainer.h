@@ -0,0 +1,43 @@
+#pragma once
+
+#include <lenny/tools/MappedFile.h>
+#include <lenny/tools/SphericalHarmonics.h>
+
+namespace lenny::tools {
+
+/**
+ * Precompiled environment: all faces and levels of a cubemap as half float RGBA (the upload format of GL_RGBA16F)
+ * together with the spherical harmonics of its base level.
+ * Opened containers are memory-mapped, so their texels can be uploaded without decoding or copying.
+ */
+class CubemapContainer {
+public:
+    CubemapContainer() = default;
+    ~CubemapContainer() = default;
+
+    //--- Writing
+    static bool write(const std::string& filePath, uint64_t key, const Cubemap& cubemap, const SphericalHarmonics& irradiance);
+
+    //--- Reading
+    bool open(const std::string& filePath, uint64_t key);  //Fails for files of another format or key
+    void close();
+    bool isOpen() const;
+    int getSize(int level = 0) const;
+    int getNumLevels() const;
+    const uint16_t* getFace(int level, int face) const;  //Face order and orientation as in Cubemap
+    SphericalHarmonics getIrradiance() const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint64_t key;
+        int32_t size, numLevels;
+        float irradiance[9][4];
+        uint64_t dataOffset;  //Texels of all levels, each level face by face
+    };
+
+    MappedFile file;
+    Header header = {};
+};
+
+}  // namespace lenny::tools
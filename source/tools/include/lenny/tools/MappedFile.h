@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace lenny::tools {
+
+/**
+ * Read-only memory mapping of a whole file, the pages are loaded on first access and shared with the file cache
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const std::string& filePath);
+    void close();
+    bool isOpen() const;
+
+    const unsigned char* getData() const;
+    size_t getSize() const;
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#if WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+}  // namespace lenny::tools
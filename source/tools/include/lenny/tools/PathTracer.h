@@ -0,0 +1,84 @@
+#pragma once
+
+#include <lenny/tools/Bvh.h>
+#include <lenny/tools/Cubemap.h>
+
+#include <atomic>
+#include <memory>
+
+namespace lenny::tools {
+
+/**
+ * Multithreaded CPU path tracer for reference images of triangle meshes lit by a point light and an environment cubemap.
+ * Surfaces have the lobes of the rasterized shading as a Lambertian and a GGX microfacet BRDF, escaping rays sample the environment.
+ * Images hold linear RGBA row by row, the first row is the bottom of the view (at normalized device coordinate y = -1).
+ */
+class PathTracer {
+public:
+    struct Texture {
+        int width = 0, height = 0;
+        std::vector<Eigen::Array3f> texels;  //Row by row, the first row at t = 0 like the texture images of OpenGL
+
+        Eigen::Array3f sample(const Eigen::Vector2f& texCoords) const;  //Bilinear, repeated outside of [0, 1]
+    };
+
+    struct Material {
+        Eigen::Array3f diffuse = Eigen::Array3f::Constant(0.8f);  //Albedo of the Lambertian lobe
+        Eigen::Array3f specular = Eigen::Array3f::Zero();          //Reflectance of the GGX lobe (without Fresnel, like the rasterized shading)
+        float roughness = 0.5f;                                    //Of the GGX lobe, the squared roughness is the distribution's alpha
+        std::shared_ptr<const Texture> texture = nullptr;          //Multiplies both lobes, like the texture the rasterized color
+    };
+
+    struct Camera {
+        Eigen::Matrix4f inverseViewProjection = Eigen::Matrix4f::Identity();  //Unprojects normalized device coordinates
+    };
+
+    struct Light {
+        Eigen::Vector3f position = Eigen::Vector3f::Zero();
+        Eigen::Array3f color = Eigen::Array3f::Ones();  //Irradiance at normal incidence, independent of the distance
+    };
+
+    typedef std::vector<Eigen::Array4f> Image;
+
+    PathTracer() = default;
+    ~PathTracer() = default;
+
+    //--- Scene
+    void clear();
+    void addMesh(const std::vector<Eigen::Vector3f>& positions, const std::vector<Eigen::Vector3f>& normals, const std::vector<Eigen::Vector2f>& texCoords,
+                 const std::vector<uint>& indices, const Material& material);  //In world coordinates, the texture coordinates may be empty
+    void build();
+    int getNumTriangles() const;
+
+    //--- Rendering (progress and stop may be called from other threads while rendering)
+    Image render(const Camera& camera, int width, int height, int numThreads = 0) const;
+    float getProgress() const;  //Of the running or last render, in [0, 1]
+    void stop();                //The running and all later renders leave the remaining rows black
+    static double computeRMSE(const Image& image, const Image& reference);  //Of the color channels
+
+public:
+    Light light;
+    bool useLight = true;
+    const Cubemap* environment = nullptr;  //Black if not set
+    float environmentIntensity = 1.f;
+    int samplesPerPixel = 16;
+    int maxBounces = 4;
+    uint64_t seed = 1;
+
+private:
+    Eigen::Array3f tracePath(Eigen::Vector3f origin, Eigen::Vector3f direction, uint64_t& state) const;
+    Eigen::Array3f sampleEnvironment(const Eigen::Vector3f& direction) const;
+
+private:
+    Bvh bvh;
+    std::vector<Eigen::Vector3f> positions;  //Three per triangle
+    std::vector<Eigen::Vector3f> normals;
+    std::vector<Eigen::Vector2f> texCoords;
+    std::vector<int> triangleMaterials;
+    std::vector<Material> materials;
+
+    mutable std::atomic<int> numRenderedRows = 0, numRows = 0;
+    std::atomic<bool> isStopped = false;
+};
+
+}  // namespace lenny::tools
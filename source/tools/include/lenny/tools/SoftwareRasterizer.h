@@ -0,0 +1,118 @@
+#pragma once
+
+#include <lenny/tools/Renderer.h>
+#include <lenny/tools/SphericalHarmonics.h>
+
+#include <optional>
+
+namespace lenny::tools {
+
+/**
+ * Tile-based CPU rasterizer with the shading of shader.frag, for rendering scenes and reflection captures without a GPU.
+ * Draw calls queue world-space triangles, render bins them into screen tiles that are rasterized in parallel (in submission order within a tile,
+ * so blending matches the GPU) and evaluates the edge functions for spans of pixels at once.
+ * Images hold linear RGBA row by row, the first row is the bottom of the view (at normalized device coordinate y = -1).
+ * Only the tools library is needed, so scenes can be rendered headless (see tools/tests).
+ */
+class SoftwareRasterizer : public Renderer {
+public:
+    struct Camera {
+        Eigen::Vector3f position = Eigen::Vector3f::Zero();
+        Eigen::Matrix4f view = Eigen::Matrix4f::Identity();
+        Eigen::Matrix4f projection = Eigen::Matrix4f::Identity();  //OpenGL clip space
+    };
+
+    struct Light {
+        Eigen::Vector3f position = Eigen::Vector3f(0.f, 5.f, 0.f);  //Relative to the camera, as in shader.frag
+        Eigen::Array3f color = Eigen::Array3f::Ones();
+        Eigen::Array3f glow = Eigen::Array3f::Zero();
+        float ambientStrength = 0.4f, diffuseStrength = 0.7f, specularStrength = 0.5f;
+    };
+
+    struct Environment {
+        const Cubemap* cubemap = nullptr;  //Reflected and drawn as skybox if set
+        bool enableMapping = true;
+        int mappingType = 3;  //0: add, 1: multiply, 2: average, 3: mix
+        float lod = 0.f;      //Level of the prefiltered mip chain
+        std::optional<SphericalHarmonics> irradiance = std::nullopt;  //Ambient light instead of the light color if set
+    };
+
+    typedef std::vector<Eigen::Array4f> Image;
+
+    SoftwareRasterizer() = default;
+    ~SoftwareRasterizer() = default;
+
+    //--- Frame
+    void clear();  //Drops the queued triangles
+    int getNumTriangles() const;
+    Image render(const Camera& camera, int width, int height, int numThreads = 0) const;
+    Cubemap renderCubemap(const Eigen::Vector3f& position, int size, int numThreads = 0) const;  //Reflection capture with the sides of DynamicCubemap
+    static Camera getCamera(const Eigen::Vector3f& eye, const Eigen::Vector3f& target, float fieldOfView,
+                            float aspectRatio);  //Looking at the target with y up, field of view in radians
+
+    //--- Meshes
+    void drawMesh(const std::vector<Eigen::Vector3f>& positions, const std::vector<Eigen::Vector3f>& normals, const std::vector<uint>& indices,
+                  const Eigen::Vector3d& position, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& scale, const Eigen::Vector4d& color) const;
+
+    //--- Draw functions
+    void drawCuboid(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& dimensions,
+                    const Eigen::Vector4d& color) const override;
+    void drawPlane(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector2d& dimensions,
+                   const Eigen::Vector4d& color) const override;
+    void drawSphere(const Eigen::Vector3d& position, const double& radius, const Eigen::Vector4d& color) const override;
+    void drawEllipsoid(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& dimensions,
+                       const Eigen::Vector4d& color) const override;
+    void drawCylinder(const Eigen::Vector3d& startPosition, const Eigen::Vector3d& endPosition, const double& radius,
+                      const Eigen::Vector4d& color) const override;
+    void drawCylinder(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const double& height, const double& radius,
+                      const Eigen::Vector4d& color) const override;
+    void drawCone(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, const double& radius, const Eigen::Vector4d& color) const override;
+    void drawArrow(const Eigen::Vector3d& startPosition, const Eigen::Vector3d& direction, const double& radius, const Eigen::Vector4d& color) const override;
+    void drawCoordinateSystem(const Eigen::Vector3d& origin, const Eigen::QuaternionD& orientation, const double& length, const double& radius,
+                              double alpha = 1.0) const override;
+    void drawCapsule(const Eigen::Vector3d& startPosition, const Eigen::Vector3d& endPosition, const double& radius,
+                     const Eigen::Vector4d& color) const override;
+    void drawCapsule(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const double& height, const double& radius,
+                     const Eigen::Vector4d& color) const override;
+    void drawTetrahedron(const std::array<Eigen::Vector3d, 4>& globalPoints, const Eigen::Vector4d& color) const override;
+    void drawLine(const std::vector<Eigen::Vector3d>& linePoints, const double& radius, const Eigen::Vector4d& color) const override;
+    void drawTrajectory(const std::vector<Eigen::Vector3d>& trajectoryPoints, const double& radius, const Eigen::Vector4d& color,
+                        const bool& showDots) const override;
+    void drawSector(const Eigen::Vector3d& center, const Eigen::QuaternionD& orientation, const double& radius, const std::pair<double, double>& angleRange,
+                    const Eigen::Vector4d& color) const override;
+    void drawRoundedCuboid(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& dimensions, const double& radius,
+                           const Eigen::Vector4d& color) const override;
+    void drawRoundedPlane(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector2d& dimensions, const double& radius,
+                          const Eigen::Vector4d& color) const override;
+
+public:
+    Eigen::Array4f clearColor = Eigen::Array4f::Ones();  //Behind everything if no environment is set
+    Light light;
+    Environment environment;
+    int tileSize = 32;  //In pixels, a multiple of the span width
+
+private:
+    struct Triangle {
+        Eigen::Vector3f positions[3], normals[3];  //In world coordinates
+        Eigen::Array4f color;
+    };
+    struct Mesh {
+        std::vector<Eigen::Vector3f> positions, normals;
+        std::vector<uint> indices;
+    };
+
+    void drawUnitMesh(const Mesh& mesh, const Eigen::Vector3d& position, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& scale,
+                      const Eigen::Vector4d& color) const;
+    Eigen::Array4f shade(const Eigen::Vector3f& position, const Eigen::Vector3f& normal, const Eigen::Array4f& color, const Eigen::Vector3f& cameraPosition,
+                         const std::array<Eigen::Array4f, 9>& irradiance) const;
+
+    static const Mesh& getCube();
+    static const Mesh& getSphere();
+    static const Mesh& getCylinder();
+    static const Mesh& getCone();
+
+private:
+    mutable std::vector<Triangle> triangles;  //Queued by the const draw functions of the interface
+};
+
+}  // namespace lenny::tools
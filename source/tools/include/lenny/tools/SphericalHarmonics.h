@@ -0,0 +1,29 @@
+#pragma once
+
+#include <lenny/tools/Cubemap.h>
+
+#include <array>
+
+namespace lenny::tools {
+
+/**
+ * Order 2 spherical harmonics (9 coefficients per color channel) of the radiance of an environment
+ */
+class SphericalHarmonics {
+public:
+    SphericalHarmonics() { coefficients.fill(Eigen::Array4f::Zero()); }  //Eigen leaves its arrays uninitialized
+    ~SphericalHarmonics() = default;
+
+    //--- Projection
+    static SphericalHarmonics project(const Cubemap& cubemap, int numThreads = 0);
+    static std::array<float, 9> evaluateBasis(const Eigen::Vector3f& direction);
+
+    //--- Irradiance
+    Eigen::Array4f evaluateIrradiance(const Eigen::Vector3f& normal) const;
+    std::array<Eigen::Array4f, 9> getIrradianceCoefficients() const;
+
+public:
+    std::array<Eigen::Array4f, 9> coefficients;
+};
+
+}  // namespace lenny::tools
@@ -2,6 +2,7 @@
 
 #include <lenny/tools/Definitions.h>
 
+#include <functional>
 #include <string>
 
 namespace lenny::tools::utils {
@@ -57,6 +58,16 @@ void addTripletDToList(Eigen::TripletDList& triplets, const int row, const int c
 void addTripletDToList_ignoreUpperElements(Eigen::TripletDList& triplets, const int row, const int col, const double value);
 void addTripletDToList_mirrorElements(Eigen::TripletDList& triplets, const int row, const int col, const double value);
 
+/**
+ * Parallel loop over [0, count), threads pull the next index until all are done (numThreads <= 0 uses all cores)
+ */
+void parallelFor(int count, int numThreads, const std::function<void(int)>& f);
+
+/**
+ * FNV-1a hash of raw bytes, pass a previous result as seed to hash several blocks
+ */
+uint64_t hash(const void* data, size_t numBytes, uint64_t seed = 14695981039346656037ull);
+
 /**
  * Read & write helpers
  */
@@ -0,0 +1,215 @@
+#include <lenny/tools/Bvh.h>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace lenny::tools {
+
+inline float getHalfArea(const Eigen::AlignedBox3f& box) {
+    if (box.isEmpty())
+        return 0.f;
+    const Eigen::Vector3f d = box.sizes();
+    return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+inline float intersectBox(const Eigen::AlignedBox3f& box, const Eigen::Vector3f& origin, const Eigen::Array3f& inverseDirection, float tMax) {
+    //Slab test, returns the entry distance or infinity if the box is missed
+    const Eigen::Array3f t0 = (box.min() - origin).array() * inverseDirection;
+    const Eigen::Array3f t1 = (box.max() - origin).array() * inverseDirection;
+    const float tEnter = std::max(t0.min(t1).maxCoeff(), 0.f);
+    const float tExit = std::min(t0.max(t1).minCoeff(), tMax);
+    return (tEnter <= tExit) ? tEnter : std::numeric_limits<float>::infinity();
+}
+
+inline bool intersectTriangle(const Eigen::Vector3f* vertices, const Eigen::Vector3f& origin, const Eigen::Vector3f& direction, float& t, float& u, float& v) {
+    //Moeller-Trumbore, both sides of the triangle are hit
+    const Eigen::Vector3f edge1 = vertices[1] - vertices[0];
+    const Eigen::Vector3f edge2 = vertices[2] - vertices[0];
+    const Eigen::Vector3f p = direction.cross(edge2);
+    const float determinant = edge1.dot(p);
+    if (std::fabs(determinant) < 1e-12f)
+        return false;
+    const float inverseDeterminant = 1.f / determinant;
+    const Eigen::Vector3f s = origin - vertices[0];
+    u = s.dot(p) * inverseDeterminant;
+    if (u < 0.f || u > 1.f)
+        return false;
+    const Eigen::Vector3f q = s.cross(edge1);
+    v = direction.dot(q) * inverseDeterminant;
+    if (v < 0.f || u + v > 1.f)
+        return false;
+    t = edge2.dot(q) * inverseDeterminant;
+    return t > 0.f;
+}
+
+void Bvh::build(const std::vector<Eigen::Vector3f>& positions) {
+    this->positions = positions;
+    const int numTriangles = getNumTriangles();
+    triangleIndices.resize(numTriangles);
+    std::iota(triangleIndices.begin(), triangleIndices.end(), 0);
+    nodes.clear();
+    if (numTriangles == 0)
+        return;
+
+    //Bounds and centroids are computed once, the partitioning only reorders the indices
+    std::vector<Eigen::AlignedBox3f> triangleBounds(numTriangles);
+    std::vector<Eigen::Vector3f> centroids(numTriangles);
+    Eigen::AlignedBox3f bounds;
+    for (int i = 0; i < numTriangles; i++) {
+        triangleBounds[i].extend(positions[3 * i]).extend(positions[3 * i + 1]).extend(positions[3 * i + 2]);
+        centroids[i] = triangleBounds[i].center();
+        bounds.extend(triangleBounds[i]);
+    }
+
+    //A binary tree has at most 2n - 1 nodes
+    nodes.reserve(2 * numTriangles);
+    nodes.push_back({bounds, 0, numTriangles});
+    subdivide(0, triangleBounds, centroids);
+}
+
+int Bvh::getNumTriangles() const {
+    return (int)positions.size() / 3;
+}
+
+int Bvh::getNumNodes() const {
+    return (int)nodes.size();
+}
+
+std::optional<Bvh::Hit> Bvh::intersect(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction, float tMax) const {
+    return traverse<false>(origin, direction, tMax);
+}
+
+bool Bvh::isOccluded(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction, float tMax) const {
+    return traverse<true>(origin, direction, tMax).has_value();
+}
+
+void Bvh::subdivide(int rootIndex, const std::vector<Eigen::AlignedBox3f>& triangleBounds, const std::vector<Eigen::Vector3f>& centroids) {
+    struct Bin {
+        Eigen::AlignedBox3f bounds;
+        int count = 0;
+    };
+
+    std::vector<std::pair<int, int>> stack = {{rootIndex, 0}};
+    while (!stack.empty()) {
+        const auto [nodeIndex, depth] = stack.back();
+        stack.pop_back();
+        const int first = nodes[nodeIndex].first, count = nodes[nodeIndex].count;
+        if (count <= maxLeafSize || depth >= MAX_DEPTH)
+            continue;
+
+        //Bin the centroids along each axis and keep the split with the lowest surface area heuristic
+        Eigen::AlignedBox3f centroidBounds;
+        for (int i = first; i < first + count; i++)
+            centroidBounds.extend(centroids[triangleIndices[i]]);
+        float bestCost = (float)count * getHalfArea(nodes[nodeIndex].bounds);
+        int bestAxis = -1, bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            const float minimum = centroidBounds.min()[axis], extent = centroidBounds.sizes()[axis];
+            if (extent <= 0.f)
+                continue;
+            std::vector<Bin> bins(numBins);
+            for (int i = first; i < first + count; i++) {
+                const int bin = std::min(numBins - 1, (int)((centroids[triangleIndices[i]][axis] - minimum) / extent * (float)numBins));
+                bins[bin].bounds.extend(triangleBounds[triangleIndices[i]]);
+                bins[bin].count++;
+            }
+
+            //Sweep from the right for the suffix areas, then from the left for the costs of the splits after each bin
+            std::vector<float> rightCosts(numBins, 0.f);
+            Eigen::AlignedBox3f rightBounds;
+            int rightCount = 0;
+            for (int bin = numBins - 1; bin > 0; bin--) {
+                rightBounds.extend(bins[bin].bounds);
+                rightCount += bins[bin].count;
+                rightCosts[bin] = (float)rightCount * getHalfArea(rightBounds);
+            }
+            Eigen::AlignedBox3f leftBounds;
+            int leftCount = 0;
+            for (int bin = 0; bin < numBins - 1; bin++) {
+                leftBounds.extend(bins[bin].bounds);
+                leftCount += bins[bin].count;
+                const float cost = (float)leftCount * getHalfArea(leftBounds) + rightCosts[bin + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = bin + 1;
+                }
+            }
+        }
+        if (bestAxis < 0)
+            continue;
+
+        //Partition the indices of the node, a split that does not separate anything keeps the leaf
+        const float minimum = centroidBounds.min()[bestAxis], extent = centroidBounds.sizes()[bestAxis];
+        int* middle = std::partition(triangleIndices.data() + first, triangleIndices.data() + first + count, [&](int triangle) -> bool {
+            return std::min(numBins - 1, (int)((centroids[triangle][bestAxis] - minimum) / extent * (float)numBins)) < bestSplit;
+        });
+        const int leftCount = (int)(middle - (triangleIndices.data() + first));
+        if (leftCount == 0 || leftCount == count)
+            continue;
+
+        //Children are stored next to each other
+        const int leftIndex = (int)nodes.size();
+        for (const auto& [childFirst, childCount] : {std::pair<int, int>(first, leftCount), std::pair<int, int>(first + leftCount, count - leftCount)}) {
+            Eigen::AlignedBox3f childBounds;
+            for (int i = childFirst; i < childFirst + childCount; i++)
+                childBounds.extend(triangleBounds[triangleIndices[i]]);
+            nodes.push_back({childBounds, childFirst, childCount});
+        }
+        nodes[nodeIndex].first = leftIndex;
+        nodes[nodeIndex].count = 0;
+        stack.push_back({leftIndex, depth + 1});
+        stack.push_back({leftIndex + 1, depth + 1});
+    }
+}
+
+template <bool ANY_HIT>
+std::optional<Bvh::Hit> Bvh::traverse(const Eigen::Vector3f& origin, const Eigen::Vector3f& direction, float tMax) const {
+    std::optional<Hit> hit = std::nullopt;
+    if (nodes.empty())
+        return hit;
+
+    //Visit the nearer child first and skip nodes behind the closest hit so far
+    const Eigen::Array3f inverseDirection = direction.cwiseInverse().array();
+    std::pair<int, float> stack[MAX_DEPTH + 2];
+    int stackSize = 0;
+    const float rootDistance = intersectBox(nodes[0].bounds, origin, inverseDirection, tMax);
+    if (rootDistance < tMax)
+        stack[stackSize++] = {0, rootDistance};
+    while (stackSize > 0) {
+        const auto [nodeIndex, distance] = stack[--stackSize];
+        if (distance >= tMax)
+            continue;
+        const Node& node = nodes[nodeIndex];
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                const int triangle = triangleIndices[i];
+                float t, u, v;
+                if (intersectTriangle(&positions[3 * triangle], origin, direction, t, u, v) && t < tMax) {
+                    tMax = t;
+                    hit = Hit{triangle, t, u, v};
+                    if (ANY_HIT)
+                        return hit;
+                }
+            }
+            continue;
+        }
+
+        float leftDistance = intersectBox(nodes[node.first].bounds, origin, inverseDirection, tMax);
+        float rightDistance = intersectBox(nodes[node.first + 1].bounds, origin, inverseDirection, tMax);
+        int near = node.first, far = node.first + 1;
+        if (rightDistance < leftDistance) {
+            std::swap(near, far);
+            std::swap(leftDistance, rightDistance);
+        }
+        if (rightDistance < tMax)
+            stack[stackSize++] = {far, rightDistance};
+        if (leftDistance < tMax)
+            stack[stackSize++] = {near, leftDistance};
+    }
+    return hit;
+}
+
+}  // namespace lenny::tools
@@ -0,0 +1,234 @@
+#include <lenny/tools/Cubemap.h>
+#include <lenny/tools/Utils.h>
+
+#include <algorithm>
+
+namespace lenny::tools {
+
+inline float radicalInverse(uint bits) {
+    //Van der Corput sequence in base 2
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return (float)bits * 2.3283064365386963e-10f;
+}
+
+Cubemap::Cubemap(int size, int numLevels) : size(size) {
+    for (int level = 0; level < numLevels; level++)
+        levels.emplace_back(6 * getSize(level) * getSize(level), Eigen::Array4f::Zero());
+}
+
+int Cubemap::getSize(int level) const {
+    return std::max(1, size >> level);
+}
+
+int Cubemap::getNumLevels() const {
+    return (int)levels.size();
+}
+
+Eigen::Array4f* Cubemap::getFace(int level, int face) {
+    return levels[level].data() + face * getSize(level) * getSize(level);
+}
+
+const Eigen::Array4f* Cubemap::getFace(int level, int face) const {
+    return levels[level].data() + face * getSize(level) * getSize(level);
+}
+
+void Cubemap::setFace(int face, const unsigned char* data, int numComponents) {
+    Eigen::Array4f* texels = getFace(0, face);
+    for (int i = 0; i < size * size; i++) {
+        const unsigned char* texel = data + i * numComponents;
+        if (numComponents < 3)
+            texels[i] = Eigen::Array4f(texel[0], texel[0], texel[0], 255.f) / 255.f;
+        else
+            texels[i] = Eigen::Array4f(texel[0], texel[1], texel[2], numComponents == 4 ? texel[3] : 255.f) / 255.f;
+    }
+}
+
+Cubemap Cubemap::fromEquirectangular(const float* data, int width, int height, int numComponents, int size, int numThreads) {
+    //Bilinear lookup with wrapping longitude and clamped latitude, the first row of the image is the +y pole
+    const auto lookup = [&](float u, float v) -> Eigen::Array4f {
+        const float x = u * (float)width - 0.5f;
+        const float y = std::clamp(v * (float)height - 0.5f, 0.f, (float)(height - 1));
+        const int x0 = (int)std::floor(x), y0 = (int)y;
+        const int y1 = std::min(y0 + 1, height - 1);
+        const float fx = x - (float)x0, fy = y - (float)y0;
+        const auto texel = [&](int tx, int ty) -> Eigen::Array4f {
+            tx = ((tx % width) + width) % width;
+            const float* t = data + ((size_t)ty * width + tx) * numComponents;
+            if (numComponents < 3)
+                return Eigen::Array4f(t[0], t[0], t[0], numComponents == 2 ? t[1] : 1.f);
+            return Eigen::Array4f(t[0], t[1], t[2], numComponents == 4 ? t[3] : 1.f);
+        };
+        return (1.f - fy) * ((1.f - fx) * texel(x0, y0) + fx * texel(x0 + 1, y0)) + fy * ((1.f - fx) * texel(x0, y1) + fx * texel(x0 + 1, y1));
+    };
+
+    //Each task fills one row of one face, neighbouring texels of a row read neighbouring texels of the source
+    Cubemap cubemap(size);
+    utils::parallelFor(6 * size, numThreads, [&](int row) -> void {
+        const int face = row / size, y = row % size;
+        Eigen::Array4f* texels = cubemap.getFace(0, face) + y * size;
+        for (int x = 0; x < size; x++) {
+            const Eigen::Vector3f direction = getDirection(face, ((float)x + 0.5f) / (float)size, ((float)y + 0.5f) / (float)size).normalized();
+            const float u = 0.5f + std::atan2(direction.x(), -direction.z()) / (2.f * (float)PI);
+            const float v = std::acos(std::clamp(direction.y(), -1.f, 1.f)) / (float)PI;
+            texels[x] = lookup(u, v);
+        }
+    });
+    return cubemap;
+}
+
+Eigen::Array4f Cubemap::sample(const Eigen::Vector3f& direction, float level) const {
+    //Bilinear within a face (clamped at its borders)
+    float s, t;
+    const int face = getFaceCoordinates(direction, s, t);
+    const auto bilinear = [&](int l) -> Eigen::Array4f {
+        const int levelSize = getSize(l);
+        const float x = std::clamp(s * levelSize - 0.5f, 0.f, (float)(levelSize - 1));
+        const float y = std::clamp(t * levelSize - 0.5f, 0.f, (float)(levelSize - 1));
+        const int x0 = (int)x, y0 = (int)y;
+        const int x1 = std::min(x0 + 1, levelSize - 1), y1 = std::min(y0 + 1, levelSize - 1);
+        const float fx = x - (float)x0, fy = y - (float)y0;
+        const Eigen::Array4f* texels = getFace(l, face);
+        return (1.f - fy) * ((1.f - fx) * texels[y0 * levelSize + x0] + fx * texels[y0 * levelSize + x1]) +
+               fy * ((1.f - fx) * texels[y1 * levelSize + x0] + fx * texels[y1 * levelSize + x1]);
+    };
+
+    //Linear between levels
+    level = std::clamp(level, 0.f, (float)(getNumLevels() - 1));
+    const int l0 = (int)level;
+    const int l1 = std::min(l0 + 1, getNumLevels() - 1);
+    const float f = level - (float)l0;
+    if (f <= 0.f || l0 == l1)
+        return bilinear(l0);
+    return (1.f - f) * bilinear(l0) + f * bilinear(l1);
+}
+
+Eigen::Vector3f Cubemap::getDirection(int face, float s, float t) {
+    //Inverse of the OpenGL cubemap face selection
+    const float sc = 2.f * s - 1.f, tc = 2.f * t - 1.f;
+    switch (face) {
+        case 0:
+            return {1.f, -tc, -sc};
+        case 1:
+            return {-1.f, -tc, sc};
+        case 2:
+            return {sc, 1.f, tc};
+        case 3:
+            return {sc, -1.f, -tc};
+        case 4:
+            return {sc, -tc, 1.f};
+        default:
+            return {-sc, -tc, -1.f};
+    }
+}
+
+int Cubemap::getFaceCoordinates(const Eigen::Vector3f& direction, float& s, float& t) {
+    //OpenGL cubemap face selection by the major axis
+    const Eigen::Vector3f a = direction.cwiseAbs();
+    int face;
+    float sc, tc, ma;
+    if (a.x() >= a.y() && a.x() >= a.z()) {
+        face = direction.x() >= 0.f ? 0 : 1;
+        sc = direction.x() >= 0.f ? -direction.z() : direction.z();
+        tc = -direction.y();
+        ma = a.x();
+    } else if (a.y() >= a.z()) {
+        face = direction.y() >= 0.f ? 2 : 3;
+        sc = direction.x();
+        tc = direction.y() >= 0.f ? direction.z() : -direction.z();
+        ma = a.y();
+    } else {
+        face = direction.z() >= 0.f ? 4 : 5;
+        sc = direction.z() >= 0.f ? direction.x() : -direction.x();
+        tc = -direction.y();
+        ma = a.z();
+    }
+    s = 0.5f * (sc / ma + 1.f);
+    t = 0.5f * (tc / ma + 1.f);
+    return face;
+}
+
+void Cubemap::generateMipmaps() {
+    //Full chain of 2x2 box filtered levels
+    levels.resize(1);
+    for (int level = 1; getSize(level - 1) > 1; level++) {
+        const int levelSize = getSize(level), parentSize = getSize(level - 1);
+        levels.emplace_back(6 * levelSize * levelSize);
+        for (int face = 0; face < 6; face++) {
+            const Eigen::Array4f* parent = getFace(level - 1, face);
+            Eigen::Array4f* texels = getFace(level, face);
+            for (int y = 0; y < levelSize; y++)
+                for (int x = 0; x < levelSize; x++)
+                    texels[y * levelSize + x] = 0.25f * (parent[(2 * y) * parentSize + 2 * x] + parent[(2 * y) * parentSize + 2 * x + 1] +
+                                                         parent[(2 * y + 1) * parentSize + 2 * x] + parent[(2 * y + 1) * parentSize + 2 * x + 1]);
+        }
+    }
+}
+
+Cubemap Cubemap::prefilterGGX(int numLevels, int numSamples, int numThreads) const {
+    //Filtered importance sampling reads from the box filtered chain, so few samples suffice
+    Cubemap source = *this;
+    source.generateMipmaps();
+
+    //The first level is the mirror reflection
+    numLevels = std::clamp(numLevels, 1, source.getNumLevels());
+    Cubemap result(size, numLevels);
+    result.levels[0] = source.levels[0];
+
+    const float texelSolidAngle = 4.f * (float)PI / (6.f * (float)size * (float)size);
+    for (int level = 1; level < numLevels; level++) {
+        //GGX samples in tangent space (normal = view = reflection direction), shared by all texels of the level
+        const float roughness = (float)level / (float)(numLevels - 1);
+        const float alpha2 = roughness * roughness * roughness * roughness;
+        struct Sample {
+            Eigen::Vector3f direction;
+            float weight, level;
+        };
+        std::vector<Sample> samples;
+        for (int i = 0; i < numSamples; i++) {
+            const float phi = 2.f * (float)PI * (float)i / (float)numSamples;
+            const float u = radicalInverse((uint)i);
+            const float cosTheta = std::sqrt((1.f - u) / (1.f + (alpha2 - 1.f) * u));
+            const float sinTheta = std::sqrt(1.f - cosTheta * cosTheta);
+            const Eigen::Vector3f halfway(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+            const Eigen::Vector3f direction = 2.f * cosTheta * halfway - Eigen::Vector3f::UnitZ();
+            if (direction.z() <= 0.f)
+                continue;
+
+            //Read from the level whose texels cover the solid angle of the sample
+            const float d = (cosTheta * cosTheta * (alpha2 - 1.f) + 1.f);
+            const float pdf = alpha2 / ((float)PI * d * d) / 4.f;
+            const float sampleSolidAngle = 1.f / ((float)numSamples * pdf + 1e-6f);
+            const float sampleLevel = std::max(0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.f, 0.f);
+            samples.push_back({direction, direction.z(), sampleLevel});
+        }
+
+        //Filter the rows of all faces in parallel
+        const int levelSize = result.getSize(level);
+        utils::parallelFor(6 * levelSize, numThreads, [&](int row) -> void {
+            const int face = row / levelSize, y = row % levelSize;
+            Eigen::Array4f* texels = result.getFace(level, face) + y * levelSize;
+            for (int x = 0; x < levelSize; x++) {
+                const Eigen::Vector3f normal = getDirection(face, ((float)x + 0.5f) / (float)levelSize, ((float)y + 0.5f) / (float)levelSize).normalized();
+                const Eigen::Vector3f up = std::abs(normal.z()) < 0.999f ? Eigen::Vector3f::UnitZ() : Eigen::Vector3f::UnitX();
+                const Eigen::Vector3f tangent = up.cross(normal).normalized();
+                const Eigen::Vector3f bitangent = normal.cross(tangent);
+
+                Eigen::Array4f sum = Eigen::Array4f::Zero();
+                float weight = 0.f;
+                for (const Sample& sample : samples) {
+                    const Eigen::Vector3f direction = sample.direction.x() * tangent + sample.direction.y() * bitangent + sample.direction.z() * normal;
+                    sum += sample.weight * source.sample(direction, sample.level);
+                    weight += sample.weight;
+                }
+                texels[x] = weight > 0.f ? Eigen::Array4f(sum / weight) : source.sample(normal, (float)level);
+            }
+        });
+    }
+    return result;
+}
+
+}  // namespace lenny::tools
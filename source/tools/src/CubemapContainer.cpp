@@ -0,0 +1,130 @@
+#include <lenny/tools/CubemapContainer.h>
+#include <lenny/tools/Logger.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace lenny::tools {
+
+inline uint16_t toHalf(float value) {
+    //IEEE 754 binary16 with rounding to nearest, overflows become infinity and tiny values zero
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000u);
+    const int exponent = (int)((bits >> 23) & 0xFFu) - 127 + 15;
+    const uint32_t mantissa = bits & 0x7FFFFFu;
+    if (((bits >> 23) & 0xFFu) == 0xFFu)
+        return sign | 0x7C00u | (mantissa ? 0x200u : 0u);
+    if (exponent >= 31)
+        return sign | 0x7C00u;
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+        const uint32_t m = mantissa | 0x800000u;
+        const int shift = 14 - exponent;
+        return sign | (uint16_t)((m + (1u << (shift - 1))) >> shift);
+    }
+    return sign | (uint16_t)(((uint32_t)exponent << 10) + ((mantissa + 0x1000u) >> 13));
+}
+
+bool CubemapContainer::write(const std::string& filePath, uint64_t key, const Cubemap& cubemap, const SphericalHarmonics& irradiance) {
+    //Written under a name of this thread and renamed when complete, so a mapped container is never truncated or seen half-written
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(filePath).parent_path(), error);
+    const std::string temporaryPath = filePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary);
+    if (!file.is_open()) {
+        LENNY_LOG_WARNING("Could not open file `%s` for writing", temporaryPath.c_str());
+        return false;
+    }
+
+    //The texels start at a page boundary
+    Header header = {};
+    std::memcpy(header.magic, "LNYENVC1", 8);
+    header.key = key;
+    header.size = cubemap.getSize();
+    header.numLevels = cubemap.getNumLevels();
+    for (int i = 0; i < 9; i++)
+        for (int c = 0; c < 4; c++)
+            header.irradiance[i][c] = irradiance.coefficients[i][c];
+    header.dataOffset = 4096;
+    std::vector<char> padding(header.dataOffset - sizeof(Header), 0);
+    file.write((const char*)&header, sizeof(Header));
+    file.write(padding.data(), (std::streamsize)padding.size());
+
+    //Convert level by level
+    std::vector<uint16_t> texels;
+    for (const Cubemap::Level& level : cubemap.levels) {
+        texels.resize(4 * level.size());
+        for (size_t i = 0; i < level.size(); i++)
+            for (int c = 0; c < 4; c++)
+                texels[4 * i + c] = toHalf(level[i][c]);
+        file.write((const char*)texels.data(), (std::streamsize)(texels.size() * sizeof(uint16_t)));
+    }
+    file.close();
+    if (!file.good()) {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    std::filesystem::rename(temporaryPath, filePath, error);
+    if (!error)
+        return true;
+    std::filesystem::remove(temporaryPath, error);
+    return false;
+}
+
+bool CubemapContainer::open(const std::string& filePath, uint64_t key) {
+    close();
+    if (!file.open(filePath))
+        return false;
+
+    //Reject files of another format or of other source data, and files that are too short for their levels
+    std::memcpy(&header, file.getData(), std::min(sizeof(Header), file.getSize()));
+    bool isValid = file.getSize() >= sizeof(Header) && std::memcmp(header.magic, "LNYENVC1", 8) == 0 && header.key == key && header.size > 0 &&
+                   header.numLevels > 0 && header.numLevels <= 32;
+    if (isValid) {
+        size_t dataSize = 0;
+        for (int level = 0; level < header.numLevels; level++)
+            dataSize += 6 * 4 * sizeof(uint16_t) * (size_t)getSize(level) * (size_t)getSize(level);
+        isValid = header.dataOffset + dataSize <= file.getSize();
+    }
+    if (!isValid)
+        close();
+    return isValid;
+}
+
+void CubemapContainer::close() {
+    file.close();
+    header = {};
+}
+
+bool CubemapContainer::isOpen() const {
+    return file.isOpen();
+}
+
+int CubemapContainer::getSize(int level) const {
+    return std::max(1, header.size >> level);
+}
+
+int CubemapContainer::getNumLevels() const {
+    return header.numLevels;
+}
+
+const uint16_t* CubemapContainer::getFace(int level, int face) const {
+    size_t offset = header.dataOffset;
+    for (int l = 0; l < level; l++)
+        offset += 6 * 4 * sizeof(uint16_t) * (size_t)getSize(l) * (size_t)getSize(l);
+    offset += (size_t)face * 4 * sizeof(uint16_t) * (size_t)getSize(level) * (size_t)getSize(level);
+    return (const uint16_t*)(file.getData() + offset);
+}
+
+SphericalHarmonics CubemapContainer::getIrradiance() const {
+    SphericalHarmonics irradiance;
+    for (int i = 0; i < 9; i++)
+        irradiance.coefficients[i] = Eigen::Array4f(header.irradiance[i][0], header.irradiance[i][1], header.irradiance[i][2], header.irradiance[i][3]);
+    return irradiance;
+}
+
+}  // namespace lenny::tools
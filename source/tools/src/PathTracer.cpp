@@ -0,0 +1,241 @@
+#include <lenny/tools/Logger.h>
+#include <lenny/tools/PathTracer.h>
+#include <lenny/tools/Utils.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace lenny::tools {
+
+inline float getRandomNumber(uint64_t& state) {
+    //SplitMix64, each pixel has its own state so the image does not depend on the number of threads
+    state += 0x9E3779B97F4A7C15ull;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return (float)(z >> 40) * 5.9604645e-8f;
+}
+
+inline Eigen::Vector3f toWorld(const Eigen::Vector3f& local, const Eigen::Vector3f& normal) {
+    //Orthonormal basis around the normal (z axis of the local frame)
+    const Eigen::Vector3f helper = (std::fabs(normal.x()) < 0.9f) ? Eigen::Vector3f::UnitX() : Eigen::Vector3f::UnitY();
+    const Eigen::Vector3f tangent = normal.cross(helper).normalized();
+    const Eigen::Vector3f bitangent = normal.cross(tangent);
+    return local.x() * tangent + local.y() * bitangent + local.z() * normal;
+}
+
+inline float computeGGX(float cosHalf, float alpha) {
+    //Normal distribution of the microfacets, normalized over the projected area
+    const float a2 = alpha * alpha;
+    const float denominator = cosHalf * cosHalf * (a2 - 1.f) + 1.f;
+    return a2 / ((float)PI * denominator * denominator);
+}
+
+inline float computeSmithG1(float cosine, float alpha) {
+    //Masking of the GGX microfacets in one direction, the product for both directions is the separable shadowing-masking term
+    const float a2 = alpha * alpha;
+    return 2.f * cosine / (cosine + std::sqrt(a2 + (1.f - a2) * cosine * cosine));
+}
+
+Eigen::Array3f PathTracer::Texture::sample(const Eigen::Vector2f& texCoords) const {
+    if (width <= 0 || height <= 0)
+        return Eigen::Array3f::Ones();
+
+    //Texel centers are at half-integer coordinates
+    const float x = (texCoords.x() - std::floor(texCoords.x())) * (float)width - 0.5f;
+    const float y = (texCoords.y() - std::floor(texCoords.y())) * (float)height - 0.5f;
+    const int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+    const float fx = x - (float)x0, fy = y - (float)y0;
+    const auto texel = [&](int i, int j) -> const Eigen::Array3f& {
+        return texels[((j % height + height) % height) * width + (i % width + width) % width];
+    };
+    return (1.f - fy) * ((1.f - fx) * texel(x0, y0) + fx * texel(x0 + 1, y0)) + fy * ((1.f - fx) * texel(x0, y0 + 1) + fx * texel(x0 + 1, y0 + 1));
+}
+
+void PathTracer::clear() {
+    positions.clear();
+    normals.clear();
+    texCoords.clear();
+    triangleMaterials.clear();
+    materials.clear();
+    bvh.build(positions);
+}
+
+void PathTracer::addMesh(const std::vector<Eigen::Vector3f>& positions, const std::vector<Eigen::Vector3f>& normals,
+                         const std::vector<Eigen::Vector2f>& texCoords, const std::vector<uint>& indices, const Material& material) {
+    //Triangles are stored unindexed, which is what the hierarchy works on
+    const int materialIndex = (int)materials.size();
+    materials.emplace_back(material);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            this->positions.emplace_back(positions[indices[i + k]]);
+            this->normals.emplace_back(normals[indices[i + k]]);
+            this->texCoords.emplace_back(texCoords.empty() ? Eigen::Vector2f::Zero() : texCoords[indices[i + k]]);
+        }
+        triangleMaterials.emplace_back(materialIndex);
+    }
+}
+
+void PathTracer::build() {
+    bvh.build(positions);
+}
+
+int PathTracer::getNumTriangles() const {
+    return (int)triangleMaterials.size();
+}
+
+PathTracer::Image PathTracer::render(const Camera& camera, int width, int height, int numThreads) const {
+    Image image(width * height, Eigen::Array4f::Zero());
+    if (bvh.getNumTriangles() != getNumTriangles())
+        LENNY_LOG_WARNING("The path tracer renders an outdated hierarchy, call build after adding meshes")
+
+    //Rows are independent, each pixel averages jittered samples
+    numRenderedRows = 0;
+    numRows = height;
+    utils::parallelFor(height, numThreads, [&](int y) -> void {
+        if (isStopped)
+            return;
+        for (int x = 0; x < width; x++) {
+            uint64_t state = seed * 0x9E3779B97F4A7C15ull + (uint64_t)y * (uint64_t)width + (uint64_t)x;
+            Eigen::Array3f color = Eigen::Array3f::Zero();
+            for (int sample = 0; sample < samplesPerPixel; sample++) {
+                const float ndcX = ((float)x + getRandomNumber(state)) / (float)width * 2.f - 1.f;
+                const float ndcY = ((float)y + getRandomNumber(state)) / (float)height * 2.f - 1.f;
+                const Eigen::Vector4f nearPoint = camera.inverseViewProjection * Eigen::Vector4f(ndcX, ndcY, -1.f, 1.f);
+                const Eigen::Vector4f farPoint = camera.inverseViewProjection * Eigen::Vector4f(ndcX, ndcY, 1.f, 1.f);
+                const Eigen::Vector3f origin = nearPoint.head<3>() / nearPoint.w();
+                const Eigen::Vector3f direction = (farPoint.head<3>() / farPoint.w() - origin).normalized();
+                color += tracePath(origin, direction, state);
+            }
+            color /= (float)std::max(samplesPerPixel, 1);
+            image[y * width + x] << color, 1.f;
+        }
+        numRenderedRows++;
+    });
+    return image;
+}
+
+float PathTracer::getProgress() const {
+    const int rows = numRows;
+    return rows > 0 ? (float)numRenderedRows / (float)rows : 0.f;
+}
+
+void PathTracer::stop() {
+    isStopped = true;
+}
+
+double PathTracer::computeRMSE(const Image& image, const Image& reference) {
+    if (image.size() != reference.size() || image.empty()) {
+        LENNY_LOG_WARNING("Images of different sizes can not be compared")
+        return -1.0;
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < image.size(); i++)
+        sum += (double)(image[i] - reference[i]).head<3>().square().sum();
+    return std::sqrt(sum / (3.0 * (double)image.size()));
+}
+
+Eigen::Array3f PathTracer::tracePath(Eigen::Vector3f origin, Eigen::Vector3f direction, uint64_t& state) const {
+    Eigen::Array3f radiance = Eigen::Array3f::Zero();
+    Eigen::Array3f throughput = Eigen::Array3f::Ones();
+    for (int bounce = 0; bounce <= maxBounces; bounce++) {
+        const std::optional<Bvh::Hit> hit = bvh.intersect(origin, direction, std::numeric_limits<float>::infinity());
+        if (!hit) {
+            radiance += throughput * sampleEnvironment(direction);
+            break;
+        }
+
+        //Geometric normal facing the ray and the interpolated normal on the same side
+        const Eigen::Vector3f* vertices = &positions[3 * hit->triangle];
+        Eigen::Vector3f geometricNormal = (vertices[1] - vertices[0]).cross(vertices[2] - vertices[0]).normalized();
+        if (geometricNormal.dot(direction) > 0.f)
+            geometricNormal = -geometricNormal;
+        const Eigen::Vector3f* vertexNormals = &normals[3 * hit->triangle];
+        Eigen::Vector3f normal = (1.f - hit->u - hit->v) * vertexNormals[0] + hit->u * vertexNormals[1] + hit->v * vertexNormals[2];
+        normal = (normal.squaredNorm() > 0.f) ? normal.normalized() : geometricNormal;
+        if (normal.dot(geometricNormal) < 0.f)
+            normal = -normal;
+        const Eigen::Vector3f position = origin + hit->t * direction + 1e-4f * geometricNormal;
+        const Eigen::Vector3f toViewer = -direction;
+        const float cosView = normal.dot(toViewer);
+
+        //Material at the hit point, the texture scales both lobes
+        const Material& material = materials[triangleMaterials[hit->triangle]];
+        Eigen::Array3f diffuse = material.diffuse, specular = material.specular;
+        if (material.texture) {
+            const Eigen::Vector2f* vertexTexCoords = &texCoords[3 * hit->triangle];
+            const Eigen::Array3f texel =
+                material.texture->sample((1.f - hit->u - hit->v) * vertexTexCoords[0] + hit->u * vertexTexCoords[1] + hit->v * vertexTexCoords[2]);
+            diffuse *= texel;
+            specular *= texel;
+        }
+        const float alpha = std::max(material.roughness * material.roughness, 1e-3f);
+
+        //Direct light of the point light through both lobes, without distance falloff like the rasterized shading
+        if (useLight) {
+            Eigen::Vector3f toLight = light.position - position;
+            const float distance = toLight.norm();
+            toLight /= distance;
+            const float cosLight = normal.dot(toLight);
+            if (cosLight > 0.f && !bvh.isOccluded(position, toLight, distance)) {
+                Eigen::Array3f brdf = diffuse / (float)PI;
+                if (cosView > 0.f) {
+                    const Eigen::Vector3f halfVector = (toViewer + toLight).normalized();
+                    brdf += specular * computeGGX(normal.dot(halfVector), alpha) * computeSmithG1(cosView, alpha) * computeSmithG1(cosLight, alpha) /
+                            (4.f * cosView * cosLight);
+                }
+                radiance += throughput * brdf * light.color * cosLight;
+            }
+        }
+
+        //Continue with one of the lobes, chosen in proportion to its reflectance, and divide by the probability of the choice
+        const float specularWeight = specular.maxCoeff(), diffuseWeight = diffuse.maxCoeff();
+        if (specularWeight + diffuseWeight <= 0.f)
+            break;
+        const float specularProbability = specularWeight / (specularWeight + diffuseWeight);
+        if (getRandomNumber(state) < specularProbability) {
+            //Half vector distributed like D(h) * cos(h), reflected about it
+            if (cosView <= 0.f)
+                break;
+            const float r1 = getRandomNumber(state), r2 = getRandomNumber(state);
+            const float cosTheta = std::sqrt((1.f - r1) / (1.f + (alpha * alpha - 1.f) * r1));
+            const float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+            const float phi = 2.f * (float)PI * r2;
+            const Eigen::Vector3f halfVector = toWorld(Eigen::Vector3f(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta), normal);
+            const float viewHalf = toViewer.dot(halfVector);
+            direction = direction - 2.f * direction.dot(halfVector) * halfVector;
+            const float cosLight = normal.dot(direction);
+            if (viewHalf <= 0.f || cosLight <= 0.f || direction.dot(geometricNormal) <= 0.f)
+                break;
+
+            //BRDF times cosine over the pdf D(h) * cos(h) / (4 * v.h), the distribution cancels
+            throughput *= specular * computeSmithG1(cosView, alpha) * computeSmithG1(cosLight, alpha) * viewHalf /
+                          (cosTheta * cosView * specularProbability);
+        } else {
+            //Cosine-weighted bounce, the pdf cancels the cosine and the 1 / pi of the Lambertian
+            throughput *= diffuse / (1.f - specularProbability);
+            const float r1 = getRandomNumber(state), r2 = getRandomNumber(state);
+            const float radius = std::sqrt(r1), phi = 2.f * (float)PI * r2;
+            direction = toWorld(Eigen::Vector3f(radius * std::cos(phi), radius * std::sin(phi), std::sqrt(std::max(0.f, 1.f - r1))), normal);
+        }
+        origin = position;
+
+        //Russian roulette once the path carries little energy
+        if (bounce >= 3) {
+            const float survival = std::min(throughput.maxCoeff(), 0.95f);
+            if (getRandomNumber(state) >= survival)
+                break;
+            throughput /= survival;
+        }
+    }
+    return radiance;
+}
+
+Eigen::Array3f PathTracer::sampleEnvironment(const Eigen::Vector3f& direction) const {
+    if (!environment)
+        return Eigen::Array3f::Zero();
+    return environment->sample(direction, 0.f).head<3>() * environmentIntensity;
+}
+
+}  // namespace lenny::tools
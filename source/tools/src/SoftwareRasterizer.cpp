@@ -0,0 +1,615 @@
+#include <lenny/tools/Logger.h>
+#include <lenny/tools/SoftwareRasterizer.h>
+#include <lenny/tools/Utils.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace lenny::tools {
+
+//Edge functions are evaluated for this many neighboring pixels of a row at once
+constexpr int SPAN_WIDTH = 8;
+typedef Eigen::Array<float, SPAN_WIDTH, 1> Span;
+
+struct ClipVertex {
+    Eigen::Vector4f clip;
+    Eigen::Vector3f position, normal;
+};
+
+struct ScreenTriangle {
+    Eigen::Vector2f points[3];  //In pixels, (0, 0) is the bottom left corner of the image
+    float depths[3];            //Window depth in [0, 1]
+    float inverseW[3];
+    Eigen::Vector3f positions[3], normals[3];
+    Eigen::Array4f color;
+    int xMin, xMax, yMin, yMax;  //Covered pixels, clamped to the image
+};
+
+inline Eigen::Matrix4f getLookAt(const Eigen::Vector3f& eye, const Eigen::Vector3f& target, const Eigen::Vector3f& up) {
+    //Same as glm::lookAt
+    const Eigen::Vector3f f = (target - eye).normalized();
+    const Eigen::Vector3f s = f.cross(up).normalized();
+    const Eigen::Vector3f u = s.cross(f);
+    Eigen::Matrix4f view = Eigen::Matrix4f::Identity();
+    view.block<1, 3>(0, 0) = s.transpose();
+    view.block<1, 3>(1, 0) = u.transpose();
+    view.block<1, 3>(2, 0) = -f.transpose();
+    view(0, 3) = -s.dot(eye);
+    view(1, 3) = -u.dot(eye);
+    view(2, 3) = f.dot(eye);
+    return view;
+}
+
+inline Eigen::Matrix4f getPerspective(float fieldOfView, float aspectRatio, float zNear, float zFar) {
+    //Same as glm::perspective (field of view in radians)
+    const float tanHalfFov = std::tan(fieldOfView / 2.f);
+    Eigen::Matrix4f projection = Eigen::Matrix4f::Zero();
+    projection(0, 0) = 1.f / (aspectRatio * tanHalfFov);
+    projection(1, 1) = 1.f / tanHalfFov;
+    projection(2, 2) = -(zFar + zNear) / (zFar - zNear);
+    projection(2, 3) = -(2.f * zFar * zNear) / (zFar - zNear);
+    projection(3, 2) = -1.f;
+    return projection;
+}
+
+inline std::vector<ClipVertex> clipNearPlane(const std::array<ClipVertex, 3>& vertices) {
+    //Sutherland-Hodgman against z >= -w, the other planes are handled by clamping to the image
+    std::vector<ClipVertex> polygon;
+    for (int i = 0; i < 3; i++) {
+        const ClipVertex& a = vertices[i];
+        const ClipVertex& b = vertices[(i + 1) % 3];
+        const float da = a.clip.z() + a.clip.w(), db = b.clip.z() + b.clip.w();
+        if (da >= 0.f)
+            polygon.emplace_back(a);
+        if ((da >= 0.f) != (db >= 0.f)) {
+            const float t = da / (da - db);
+            polygon.push_back({a.clip + t * (b.clip - a.clip), a.position + t * (b.position - a.position), a.normal + t * (b.normal - a.normal)});
+        }
+    }
+    return polygon;
+}
+
+inline Eigen::Array4f blend(const Eigen::Array4f& source, const Eigen::Array4f& destination) {
+    //glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA), for color and alpha
+    return source * source[3] + destination * (1.f - source[3]);
+}
+
+void SoftwareRasterizer::clear() {
+    triangles.clear();
+}
+
+int SoftwareRasterizer::getNumTriangles() const {
+    return (int)triangles.size();
+}
+
+SoftwareRasterizer::Image SoftwareRasterizer::render(const Camera& camera, int width, int height, int numThreads) const {
+    Image image(std::max(width, 0) * std::max(height, 0), clearColor);
+    if (width <= 0 || height <= 0)
+        return image;
+    if (tileSize <= 0 || tileSize % SPAN_WIDTH != 0) {
+        LENNY_LOG_WARNING("Tile size %d is not a positive multiple of %d", tileSize, SPAN_WIDTH)
+        return image;
+    }
+
+    //--- Geometry: project, clip at the near plane and set up screen triangles in submission order
+    const Eigen::Matrix4f viewProjection = camera.projection * camera.view;
+    std::vector<ScreenTriangle> screenTriangles;
+    screenTriangles.reserve(triangles.size());
+    for (const Triangle& triangle : triangles) {
+        std::array<ClipVertex, 3> vertices;
+        for (int k = 0; k < 3; k++)
+            vertices[k] = {viewProjection * triangle.positions[k].homogeneous(), triangle.positions[k], triangle.normals[k]};
+        const std::vector<ClipVertex> polygon = clipNearPlane(vertices);
+
+        for (size_t i = 1; i + 1 < polygon.size(); i++) {
+            ScreenTriangle screenTriangle;
+            Eigen::AlignedBox2f bounds;
+            for (int k = 0; k < 3; k++) {
+                const ClipVertex& vertex = polygon[(k == 0) ? 0 : i + k - 1];
+                const float inverseW = 1.f / vertex.clip.w();
+                screenTriangle.points[k] = Eigen::Vector2f((vertex.clip.x() * inverseW * 0.5f + 0.5f) * (float)width,
+                                                           (vertex.clip.y() * inverseW * 0.5f + 0.5f) * (float)height);
+                screenTriangle.depths[k] = vertex.clip.z() * inverseW * 0.5f + 0.5f;
+                screenTriangle.inverseW[k] = inverseW;
+                screenTriangle.positions[k] = vertex.position;
+                screenTriangle.normals[k] = vertex.normal;
+                bounds.extend(screenTriangle.points[k]);
+            }
+            screenTriangle.color = triangle.color;
+
+            //Pixels whose centers may be covered
+            screenTriangle.xMin = std::max(0, (int)std::floor(bounds.min().x() - 0.5f));
+            screenTriangle.yMin = std::max(0, (int)std::floor(bounds.min().y() - 0.5f));
+            screenTriangle.xMax = std::min(width - 1, (int)std::ceil(bounds.max().x() - 0.5f));
+            screenTriangle.yMax = std::min(height - 1, (int)std::ceil(bounds.max().y() - 0.5f));
+            if (screenTriangle.xMin <= screenTriangle.xMax && screenTriangle.yMin <= screenTriangle.yMax)
+                screenTriangles.emplace_back(screenTriangle);
+        }
+    }
+
+    //--- Binning: every tile lists the overlapping triangles, still in submission order so blending matches the GPU
+    const int numTilesX = (width + tileSize - 1) / tileSize;
+    const int numTilesY = (height + tileSize - 1) / tileSize;
+    std::vector<std::vector<int>> bins(numTilesX * numTilesY);
+    for (int i = 0; i < (int)screenTriangles.size(); i++) {
+        const ScreenTriangle& triangle = screenTriangles[i];
+        for (int tileY = triangle.yMin / tileSize; tileY <= triangle.yMax / tileSize; tileY++)
+            for (int tileX = triangle.xMin / tileSize; tileX <= triangle.xMax / tileSize; tileX++)
+                bins[tileY * numTilesX + tileX].emplace_back(i);
+    }
+
+    //--- Shading inputs shared by all tiles
+    std::array<Eigen::Array4f, 9> irradiance;
+    irradiance.fill(Eigen::Array4f::Zero());
+    if (environment.irradiance)
+        irradiance = environment.irradiance->getIrradianceCoefficients();
+    const Eigen::Matrix4f inverseViewProjection = viewProjection.inverse();
+
+    //--- Rasterization: tiles cover disjoint pixels and have their own depth buffer
+    utils::parallelFor(numTilesX * numTilesY, numThreads, [&](int tile) -> void {
+        const int x0 = (tile % numTilesX) * tileSize, y0 = (tile / numTilesX) * tileSize;
+        const int x1 = std::min(x0 + tileSize, width), y1 = std::min(y0 + tileSize, height);
+        std::vector<float> depthBuffer(tileSize * tileSize, 1.f);
+
+        //Background, the skybox samples the environment in the direction of the pixel
+        if (environment.cubemap) {
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    const float ndcX = ((float)x + 0.5f) / (float)width * 2.f - 1.f, ndcY = ((float)y + 0.5f) / (float)height * 2.f - 1.f;
+                    const Eigen::Vector4f nearPoint = inverseViewProjection * Eigen::Vector4f(ndcX, ndcY, -1.f, 1.f);
+                    const Eigen::Vector4f farPoint = inverseViewProjection * Eigen::Vector4f(ndcX, ndcY, 1.f, 1.f);
+                    const Eigen::Vector3f direction = farPoint.head<3>() / farPoint.w() - nearPoint.head<3>() / nearPoint.w();
+                    image[y * width + x] = environment.cubemap->sample(direction, 0.f);
+                }
+            }
+        }
+
+        const Span offsets = Span::LinSpaced(0.5f, (float)SPAN_WIDTH - 0.5f);
+        for (const int index : bins[tile]) {
+            const ScreenTriangle& triangle = screenTriangles[index];
+            const Eigen::Vector2f* p = triangle.points;
+            float area = (p[1] - p[0]).x() * (p[2] - p[0]).y() - (p[1] - p[0]).y() * (p[2] - p[0]).x();
+            if (std::fabs(area) < 1e-12f)
+                continue;
+
+            //Edge k is opposite to vertex k. Both orientations are drawn (no culling), so the edges are flipped for clockwise triangles.
+            //A shared edge is evaluated from the same base vertex in both triangles, which gives exactly opposite values.
+            //Pixel centers exactly on an edge belong to one of the two triangles only.
+            struct Edge {
+                Eigen::Vector2f base, delta;
+                float threshold;
+            } edges[3];
+            const float orientation = (area > 0.f) ? 1.f : -1.f;
+            area *= orientation;
+            for (int k = 0; k < 3; k++) {
+                Eigen::Vector2f a = p[(k + 1) % 3], b = p[(k + 2) % 3];
+                float sign = orientation;
+                if (std::tie(b.x(), b.y()) < std::tie(a.x(), a.y())) {
+                    std::swap(a, b);
+                    sign = -sign;
+                }
+                edges[k].base = a;
+                edges[k].delta = sign * (b - a);
+                const bool isOwner = (edges[k].delta.y() < 0.f) || (edges[k].delta.y() == 0.f && edges[k].delta.x() > 0.f);
+                edges[k].threshold = isOwner ? 0.f : std::numeric_limits<float>::min();
+            }
+
+            const int xBegin = x0 + (std::max(triangle.xMin, x0) - x0) / SPAN_WIDTH * SPAN_WIDTH;
+            const int xEnd = std::min(triangle.xMax + 1, x1);
+            for (int y = std::max(triangle.yMin, y0); y <= std::min(triangle.yMax, y1 - 1); y++) {
+                const float py = (float)y + 0.5f;
+                for (int x = xBegin; x < xEnd; x += SPAN_WIDTH) {
+                    const Span px = offsets + (float)x;
+                    Span weights[3];
+                    Eigen::Array<bool, SPAN_WIDTH, 1> mask = (px < (float)xEnd);
+                    for (int k = 0; k < 3; k++) {
+                        const Edge& edge = edges[k];
+                        weights[k] = edge.delta.x() * (py - edge.base.y()) - edge.delta.y() * (px - edge.base.x());
+                        mask = mask && (weights[k] >= edge.threshold);
+                    }
+                    if (!mask.any())
+                        continue;
+
+                    //Depth is affine in screen space, the attributes are interpolated perspective-correct
+                    for (int k = 0; k < 3; k++)
+                        weights[k] /= area;
+                    const Span depth = weights[0] * triangle.depths[0] + weights[1] * triangle.depths[1] + weights[2] * triangle.depths[2];
+                    for (int i = 0; i < SPAN_WIDTH; i++) {
+                        if (!mask[i])
+                            continue;
+                        float& storedDepth = depthBuffer[(y - y0) * tileSize + (x - x0 + i)];
+                        if (!(depth[i] < storedDepth) || depth[i] < 0.f)
+                            continue;
+                        storedDepth = depth[i];
+
+                        const float w0 = weights[0][i] * triangle.inverseW[0], w1 = weights[1][i] * triangle.inverseW[1], w2 = weights[2][i] * triangle.inverseW[2];
+                        const float normalization = 1.f / (w0 + w1 + w2);
+                        const Eigen::Vector3f position = (w0 * triangle.positions[0] + w1 * triangle.positions[1] + w2 * triangle.positions[2]) * normalization;
+                        const Eigen::Vector3f normal = (w0 * triangle.normals[0] + w1 * triangle.normals[1] + w2 * triangle.normals[2]) * normalization;
+                        Eigen::Array4f& pixel = image[y * width + x + i];
+                        pixel = blend(shade(position, normal, triangle.color, camera.position, irradiance), pixel);
+                    }
+                }
+            }
+        }
+    });
+    return image;
+}
+
+Cubemap SoftwareRasterizer::renderCubemap(const Eigen::Vector3f& position, int size, int numThreads) const {
+    //Views of the sides as in DynamicCubemap, image rows map to face rows since the first row is at t = 0
+    static const std::array<std::pair<Eigen::Vector3f, Eigen::Vector3f>, 6> sides = {
+        std::make_pair(Eigen::Vector3f(1.f, 0.f, 0.f), Eigen::Vector3f(0.f, -1.f, 0.f)),  std::make_pair(Eigen::Vector3f(-1.f, 0.f, 0.f), Eigen::Vector3f(0.f, -1.f, 0.f)),
+        std::make_pair(Eigen::Vector3f(0.f, 1.f, 0.f), Eigen::Vector3f(0.f, 0.f, 1.f)),   std::make_pair(Eigen::Vector3f(0.f, -1.f, 0.f), Eigen::Vector3f(0.f, 0.f, -1.f)),
+        std::make_pair(Eigen::Vector3f(0.f, 0.f, 1.f), Eigen::Vector3f(0.f, -1.f, 0.f)),  std::make_pair(Eigen::Vector3f(0.f, 0.f, -1.f), Eigen::Vector3f(0.f, -1.f, 0.f))};
+
+    Cubemap cubemap(size);
+    Camera camera;
+    camera.position = position;
+    camera.projection = getPerspective((float)PI / 2.f, 1.f, 0.1f, 1000.f);
+    for (int face = 0; face < 6; face++) {
+        camera.view = getLookAt(position, position + sides[face].first, sides[face].second);
+        const Image image = render(camera, size, size, numThreads);
+        std::copy(image.begin(), image.end(), cubemap.getFace(0, face));
+    }
+    return cubemap;
+}
+
+SoftwareRasterizer::Camera SoftwareRasterizer::getCamera(const Eigen::Vector3f& eye, const Eigen::Vector3f& target, float fieldOfView, float aspectRatio) {
+    Camera camera;
+    camera.position = eye;
+    camera.view = getLookAt(eye, target, Eigen::Vector3f::UnitY());
+    camera.projection = getPerspective(fieldOfView, aspectRatio, 0.1f, 1000.f);
+    return camera;
+}
+
+void SoftwareRasterizer::drawMesh(const std::vector<Eigen::Vector3f>& positions, const std::vector<Eigen::Vector3f>& normals, const std::vector<uint>& indices,
+                                  const Eigen::Vector3d& position, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& scale,
+                                  const Eigen::Vector4d& color) const {
+    //Normals transform with the inverse transpose of the model matrix, which is R * S^-1 for a rotation and a scaling
+    const Eigen::Matrix3f rotation = orientation.normalized().toRotationMatrix().cast<float>();
+    const Eigen::Vector3f translation = position.cast<float>(), scaling = scale.cast<float>();
+    const Eigen::Matrix3f normalMatrix = rotation * scaling.cwiseInverse().asDiagonal();
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        Triangle triangle;
+        for (int k = 0; k < 3; k++) {
+            triangle.positions[k] = rotation * positions[indices[i + k]].cwiseProduct(scaling) + translation;
+            triangle.normals[k] = normalMatrix * normals[indices[i + k]];
+        }
+        triangle.color = color.cast<float>().array();
+        triangles.emplace_back(triangle);
+    }
+}
+
+void SoftwareRasterizer::drawCuboid(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& dimensions,
+                                    const Eigen::Vector4d& color) const {
+    drawUnitMesh(getCube(), COM, orientation, dimensions, color);
+}
+
+void SoftwareRasterizer::drawPlane(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector2d& dimensions,
+                                   const Eigen::Vector4d& color) const {
+    drawCuboid(COM, orientation, Eigen::Vector3d(dimensions[0], 1e-3, dimensions[1]), color);
+}
+
+void SoftwareRasterizer::drawSphere(const Eigen::Vector3d& position, const double& radius, const Eigen::Vector4d& color) const {
+    drawUnitMesh(getSphere(), position, Eigen::QuaternionD::Identity(), radius * Eigen::Vector3d::Ones(), color);
+}
+
+void SoftwareRasterizer::drawEllipsoid(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& dimensions,
+                                       const Eigen::Vector4d& color) const {
+    drawUnitMesh(getSphere(), COM, orientation, dimensions, color);
+}
+
+void SoftwareRasterizer::drawCylinder(const Eigen::Vector3d& startPosition, const Eigen::Vector3d& endPosition, const double& radius,
+                                      const Eigen::Vector4d& color) const {
+    const Eigen::Vector3d direction = endPosition - startPosition;
+    const double length = direction.norm();
+    if (length < 10e-10)
+        return;
+    drawUnitMesh(getCylinder(), startPosition, Eigen::QuaternionD::FromTwoVectors(Eigen::Vector3d::UnitZ(), direction),
+                 Eigen::Vector3d(radius, radius, length), color);
+}
+
+void SoftwareRasterizer::drawCylinder(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const double& height, const double& radius,
+                                      const Eigen::Vector4d& color) const {
+    const Eigen::Vector3d startPosition = COM + orientation * Eigen::Vector3d(0.0, height / 2.0, 0.0);
+    const Eigen::Vector3d endPosition = COM - orientation * Eigen::Vector3d(0.0, height / 2.0, 0.0);
+    drawCylinder(startPosition, endPosition, radius, color);
+}
+
+void SoftwareRasterizer::drawCone(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, const double& radius, const Eigen::Vector4d& color) const {
+    const double length = direction.norm();
+    if (length < 10e-10)
+        return;
+    drawUnitMesh(getCone(), origin, Eigen::QuaternionD::FromTwoVectors(Eigen::Vector3d::UnitY(), direction), Eigen::Vector3d(radius, length, radius), color);
+}
+
+void SoftwareRasterizer::drawArrow(const Eigen::Vector3d& startPosition, const Eigen::Vector3d& direction, const double& radius,
+                                   const Eigen::Vector4d& color) const {
+    Eigen::Vector3d dir = direction;
+    for (uint i = 0; i < 3; i++)
+        if (fabs(dir[i]) < 1e-6)
+            dir[i] = 1e-6;
+
+    const double coneRadius = 1.5 * radius;
+    const Eigen::Vector3d coneDir = dir / dir.norm() * coneRadius * 1.5;
+    const Eigen::Vector3d cylinderEnd = startPosition + dir - coneDir;
+
+    drawCylinder(startPosition, cylinderEnd, radius, color);
+    drawCone(cylinderEnd, coneDir, coneRadius, color);
+}
+
+void SoftwareRasterizer::drawCoordinateSystem(const Eigen::Vector3d& origin, const Eigen::QuaternionD& orientation, const double& length, const double& radius,
+                                              double alpha) const {
+    drawArrow(origin, length * orientation.matrix().col(0), radius, Eigen::Vector4d(0.75, 0.0, 0.0, alpha));
+    drawArrow(origin, length * orientation.matrix().col(1), radius, Eigen::Vector4d(0.0, 0.75, 0.0, alpha));
+    drawArrow(origin, length * orientation.matrix().col(2), radius, Eigen::Vector4d(0.0, 0.0, 0.75, alpha));
+}
+
+void SoftwareRasterizer::drawCapsule(const Eigen::Vector3d& startPosition, const Eigen::Vector3d& endPosition, const double& radius,
+                                     const Eigen::Vector4d& color) const {
+    drawCylinder(startPosition, endPosition, radius, color);
+    drawSphere(startPosition, radius, color);
+    drawSphere(endPosition, radius, color);
+}
+
+void SoftwareRasterizer::drawCapsule(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const double& height, const double& radius,
+                                     const Eigen::Vector4d& color) const {
+    const Eigen::Vector3d startPosition = COM + orientation * Eigen::Vector3d(0.0, height / 2.0, 0.0);
+    const Eigen::Vector3d endPosition = COM - orientation * Eigen::Vector3d(0.0, height / 2.0, 0.0);
+    drawCapsule(startPosition, endPosition, radius, color);
+}
+
+void SoftwareRasterizer::drawTetrahedron(const std::array<Eigen::Vector3d, 4>& globalPoints, const Eigen::Vector4d& color) const {
+    //Shares one normal between all vertices, like the OpenGL renderer
+    static const std::vector<uint> indices = {0, 1, 2, 1, 2, 3, 0, 1, 3, 0, 2, 3};
+    std::vector<Eigen::Vector3f> positions(4), normals(4, Eigen::Vector3f::Ones().normalized());
+    for (int i = 0; i < 4; i++)
+        positions[i] = globalPoints[i].cast<float>();
+    drawMesh(positions, normals, indices, Eigen::Vector3d::Zero(), Eigen::QuaternionD::Identity(), Eigen::Vector3d::Ones(), color);
+}
+
+void SoftwareRasterizer::drawLine(const std::vector<Eigen::Vector3d>& linePoints, const double& radius, const Eigen::Vector4d& color) const {
+    for (size_t i = 0; i + 1 < linePoints.size(); i++)
+        drawCylinder(linePoints[i], linePoints[i + 1], radius, color);
+}
+
+void SoftwareRasterizer::drawTrajectory(const std::vector<Eigen::Vector3d>& trajectoryPoints, const double& radius, const Eigen::Vector4d& color,
+                                        const bool& showDots) const {
+    drawLine(trajectoryPoints, radius, color);
+    if (showDots) {
+        const double dotRadius = 2.0 * radius;
+        for (uint i = 0; i < trajectoryPoints.size(); i++)
+            drawSphere(trajectoryPoints[i], dotRadius, color);
+    }
+}
+
+void SoftwareRasterizer::drawSector(const Eigen::Vector3d& center, const Eigen::QuaternionD& orientation, const double& radius,
+                                    const std::pair<double, double>& angleRange, const Eigen::Vector4d& color) const {
+    //Fan of one degree wedges in the xz-plane (each covering the degree before its angle), with the thickness of the sector mesh
+    const double halfThickness = 0.5e-3 * radius;
+    Mesh wedges;
+    for (double angle = angleRange.first; angle < angleRange.second; angle += PI / 180.0) {
+        const Eigen::Vector3f a = (radius * Eigen::Vector3d(std::sin(angle), 0.0, std::cos(angle))).cast<float>();
+        const Eigen::Vector3f b = (radius * Eigen::Vector3d(std::sin(angle - PI / 180.0), 0.0, std::cos(angle - PI / 180.0))).cast<float>();
+        for (const double side : {1.0, -1.0}) {
+            const Eigen::Vector3f offset = (side * halfThickness * Eigen::Vector3d::UnitY()).cast<float>();
+            const uint first = (uint)wedges.positions.size();
+            for (const Eigen::Vector3f& point : {Eigen::Vector3f(offset), Eigen::Vector3f(a + offset), Eigen::Vector3f(b + offset)}) {
+                wedges.positions.emplace_back(point);
+                wedges.normals.emplace_back((float)side * Eigen::Vector3f::UnitY());
+            }
+            wedges.indices.insert(wedges.indices.end(), {first, first + 1, first + 2});
+        }
+    }
+    drawUnitMesh(wedges, center, orientation, Eigen::Vector3d::Ones(), color);
+}
+
+void SoftwareRasterizer::drawRoundedCuboid(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& dimensions,
+                                           const double& radius, const Eigen::Vector4d& color) const {
+    //Every face is a grid of directions like a cubemap side, each pushed out by the radius from its corner of the inner box.
+    //The two middle samples of an axis have the face normal and span the flat part, the others round the edges and corners in steps of
+    //up to 45 degrees, where the neighboring face continues. The radius is limited to half of each dimension.
+    const Eigen::Vector3f halfDimensions = (0.5 * dimensions).cast<float>();
+    const Eigen::Vector3f radii = halfDimensions.cwiseMin((float)radius).cwiseMax(1e-6f);
+    const Eigen::Vector3f inner = (halfDimensions - radii).cwiseMax(0.f);
+    const int numSteps = 4;
+    std::vector<std::pair<float, float>> samples;  //Side and slope of the direction along an axis
+    for (int k = numSteps; k >= 0; k--)
+        samples.emplace_back(-1.f, std::tan(0.25f * (float)PI * (float)k / (float)numSteps));
+    for (int k = 0; k <= numSteps; k++)
+        samples.emplace_back(1.f, std::tan(0.25f * (float)PI * (float)k / (float)numSteps));
+
+    Mesh mesh;
+    const uint numSamples = (uint)samples.size();
+    for (int axis = 0; axis < 3; axis++) {
+        for (const float side : {1.f, -1.f}) {
+            const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            const uint first = (uint)mesh.positions.size();
+            for (const auto& [sideU, slopeU] : samples) {
+                for (const auto& [sideV, slopeV] : samples) {
+                    Eigen::Vector3f direction, corner;
+                    direction[axis] = side;
+                    direction[u] = sideU * slopeU;
+                    direction[v] = sideV * slopeV;
+                    direction.normalize();
+                    corner[axis] = side * inner[axis];
+                    corner[u] = sideU * inner[u];
+                    corner[v] = sideV * inner[v];
+                    mesh.positions.emplace_back(corner + radii.cwiseProduct(direction));
+                    mesh.normals.emplace_back(direction.cwiseQuotient(radii).normalized());
+                }
+            }
+            for (uint i = 0; i + 1 < numSamples; i++) {
+                for (uint j = 0; j + 1 < numSamples; j++) {
+                    const uint a = first + i * numSamples + j, b = a + numSamples;
+                    if (side > 0.f)
+                        mesh.indices.insert(mesh.indices.end(), {a, b, b + 1, a, b + 1, a + 1});
+                    else
+                        mesh.indices.insert(mesh.indices.end(), {a, b + 1, b, a, a + 1, b + 1});
+                }
+            }
+        }
+    }
+    drawUnitMesh(mesh, COM, orientation, Eigen::Vector3d::Ones(), color);
+}
+
+void SoftwareRasterizer::drawRoundedPlane(const Eigen::Vector3d& COM, const Eigen::QuaternionD& orientation, const Eigen::Vector2d& dimensions,
+                                          const double& radius, const Eigen::Vector4d& color) const {
+    drawRoundedCuboid(COM, orientation, Eigen::Vector3d(dimensions[0], 1e-3, dimensions[1]), radius, color);
+}
+
+void SoftwareRasterizer::drawUnitMesh(const Mesh& mesh, const Eigen::Vector3d& position, const Eigen::QuaternionD& orientation, const Eigen::Vector3d& scale,
+                                      const Eigen::Vector4d& color) const {
+    drawMesh(mesh.positions, mesh.normals, mesh.indices, position, orientation, scale, color);
+}
+
+Eigen::Array4f SoftwareRasterizer::shade(const Eigen::Vector3f& position, const Eigen::Vector3f& normal, const Eigen::Array4f& color,
+                                         const Eigen::Vector3f& cameraPosition, const std::array<Eigen::Array4f, 9>& irradiance) const {
+    //Basic shading of shader.frag with the object color
+    const Eigen::Vector3f norm = normal.normalized();
+    const Eigen::Vector3f viewDir = (cameraPosition - position).normalized();
+    const Eigen::Vector3f lightDir = ((cameraPosition + light.position) - position).normalized();
+
+    Eigen::Array3f ambient = light.ambientStrength * light.color;
+    if (environment.irradiance) {
+        const std::array<float, 9> basis = SphericalHarmonics::evaluateBasis(norm);
+        Eigen::Array4f sum = Eigen::Array4f::Zero();
+        for (int i = 0; i < 9; i++)
+            sum += basis[i] * irradiance[i];
+        ambient = light.ambientStrength * sum.head<3>().max(0.f);
+    }
+    const Eigen::Array3f diffuse = light.diffuseStrength * std::max(norm.dot(lightDir), 0.f) * light.color;
+    const Eigen::Vector3f reflectDir = -lightDir - 2.f * norm.dot(-lightDir) * norm;
+    const Eigen::Array3f specular = light.specularStrength * std::pow(std::max(viewDir.dot(reflectDir), 0.f), 32.f) * light.color;
+
+    Eigen::Array3f rgb = (ambient + diffuse + specular) * color.head<3>();
+    rgb += std::max(norm.dot(-viewDir), 0.f) * light.glow * rgb;
+    Eigen::Array4f fragColor;
+    fragColor << rgb, color[3];
+
+    //Environment mapping of the reflected view ray
+    if (environment.cubemap && environment.enableMapping) {
+        const Eigen::Vector3f rayDir = -viewDir;
+        const Eigen::Array4f envColor = environment.cubemap->sample(rayDir - 2.f * norm.dot(rayDir) * norm, environment.lod);
+        const float brightness = std::clamp(fragColor.head<3>().mean(), 0.f, 1.f);
+        if (environment.mappingType == 0)
+            fragColor = fragColor + envColor * 0.25f;
+        else if (environment.mappingType == 1)
+            fragColor = fragColor * envColor;
+        else if (environment.mappingType == 2)
+            fragColor = (fragColor + envColor) / 2.f;
+        else if (environment.mappingType == 3)
+            fragColor = fragColor * (1.f - brightness) + envColor * brightness;
+    }
+    return fragColor;
+}
+
+const SoftwareRasterizer::Mesh& SoftwareRasterizer::getCube() {
+    //Unit cube around the origin with flat faces, like cube.obj
+    static const Mesh mesh = []() -> Mesh {
+        Mesh mesh;
+        for (int axis = 0; axis < 3; axis++) {
+            for (const float side : {1.f, -1.f}) {
+                const Eigen::Vector3f normal = side * Eigen::Vector3f::Unit(axis);
+                const Eigen::Vector3f u = 0.5f * Eigen::Vector3f::Unit((axis + 1) % 3), v = 0.5f * Eigen::Vector3f::Unit((axis + 2) % 3);
+                const uint first = (uint)mesh.positions.size();
+                for (const Eigen::Vector3f& corner : {Eigen::Vector3f(-u - v), Eigen::Vector3f(u - v), Eigen::Vector3f(u + v), Eigen::Vector3f(-u + v)}) {
+                    mesh.positions.emplace_back(0.5f * normal + corner);
+                    mesh.normals.emplace_back(normal);
+                }
+                mesh.indices.insert(mesh.indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+            }
+        }
+        return mesh;
+    }();
+    return mesh;
+}
+
+const SoftwareRasterizer::Mesh& SoftwareRasterizer::getSphere() {
+    //Unit sphere with smooth normals
+    static const Mesh mesh = []() -> Mesh {
+        const int numSlices = 32, numStacks = 16;
+        Mesh mesh;
+        for (int i = 0; i <= numStacks; i++) {
+            const double theta = PI * (double)i / (double)numStacks;
+            for (int j = 0; j <= numSlices; j++) {
+                const double phi = 2.0 * PI * (double)j / (double)numSlices;
+                const Eigen::Vector3f point = Eigen::Vector3d(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)).cast<float>();
+                mesh.positions.emplace_back(point);
+                mesh.normals.emplace_back(point);
+            }
+        }
+        for (int i = 0; i < numStacks; i++) {
+            for (int j = 0; j < numSlices; j++) {
+                const uint a = i * (numSlices + 1) + j, b = a + numSlices + 1;
+                mesh.indices.insert(mesh.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+            }
+        }
+        return mesh;
+    }();
+    return mesh;
+}
+
+const SoftwareRasterizer::Mesh& SoftwareRasterizer::getCylinder() {
+    //Radius 1 around the z-axis from z = 0 to z = 1, like cylinder.obj
+    static const Mesh mesh = []() -> Mesh {
+        const int numSlices = 32;
+        Mesh mesh;
+        for (int j = 0; j <= numSlices; j++) {
+            const double phi = 2.0 * PI * (double)j / (double)numSlices;
+            const Eigen::Vector3f radial = Eigen::Vector3d(std::cos(phi), std::sin(phi), 0.0).cast<float>();
+            for (const float z : {0.f, 1.f}) {
+                mesh.positions.emplace_back(radial + z * Eigen::Vector3f::UnitZ());
+                mesh.normals.emplace_back(radial);
+            }
+        }
+        for (int j = 0; j < numSlices; j++) {
+            const uint a = 2 * j;
+            mesh.indices.insert(mesh.indices.end(), {a, a + 2, a + 1, a + 1, a + 2, a + 3});
+        }
+        for (const float z : {0.f, 1.f}) {
+            const Eigen::Vector3f normal = (z > 0.f ? 1.f : -1.f) * Eigen::Vector3f::UnitZ();
+            const uint center = (uint)mesh.positions.size();
+            mesh.positions.emplace_back(z * Eigen::Vector3f::UnitZ());
+            mesh.normals.emplace_back(normal);
+            for (int j = 0; j <= numSlices; j++) {
+                const double phi = 2.0 * PI * (double)j / (double)numSlices;
+                mesh.positions.emplace_back(Eigen::Vector3d(std::cos(phi), std::sin(phi), z).cast<float>());
+                mesh.normals.emplace_back(normal);
+            }
+            for (int j = 0; j < numSlices; j++)
+                mesh.indices.insert(mesh.indices.end(), {center, center + 1 + j, center + 2 + j});
+        }
+        return mesh;
+    }();
+    return mesh;
+}
+
+const SoftwareRasterizer::Mesh& SoftwareRasterizer::getCone() {
+    //Base of radius 1 in the xz-plane, apex at y = 1, like cone.obj (in meters)
+    static const Mesh mesh = []() -> Mesh {
+        const int numSlices = 32;
+        Mesh mesh;
+        for (int j = 0; j < numSlices; j++) {
+            const double phi0 = 2.0 * PI * (double)j / (double)numSlices, phi1 = 2.0 * PI * (double)(j + 1) / (double)numSlices;
+            const Eigen::Vector3f a = Eigen::Vector3d(std::cos(phi0), 0.0, std::sin(phi0)).cast<float>();
+            const Eigen::Vector3f b = Eigen::Vector3d(std::cos(phi1), 0.0, std::sin(phi1)).cast<float>();
+            const uint first = (uint)mesh.positions.size();
+
+            //Side, the apex takes the normal of the middle of the slice
+            mesh.positions.insert(mesh.positions.end(), {a, b, Eigen::Vector3f::UnitY()});
+            mesh.normals.insert(mesh.normals.end(), {(a + Eigen::Vector3f::UnitY()).normalized(), (b + Eigen::Vector3f::UnitY()).normalized(),
+                                                     ((a + b).normalized() + Eigen::Vector3f::UnitY()).normalized()});
+
+            //Base
+            mesh.positions.insert(mesh.positions.end(), {a, b, Eigen::Vector3f::Zero()});
+            mesh.normals.insert(mesh.normals.end(), 3, -Eigen::Vector3f::UnitY());
+            mesh.indices.insert(mesh.indices.end(), {first, first + 1, first + 2, first + 3, first + 4, first + 5});
+        }
+        return mesh;
+    }();
+    return mesh;
+}
+
+}  // namespace lenny::tools
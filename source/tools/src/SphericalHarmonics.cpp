@@ -0,0 +1,67 @@
+#include <lenny/tools/SphericalHarmonics.h>
+#include <lenny/tools/Utils.h>
+
+namespace lenny::tools {
+
+SphericalHarmonics SphericalHarmonics::project(const Cubemap& cubemap, int numThreads) {
+    //Each row of each face is reduced into its own partial sums, which are added up in a fixed order afterwards
+    const int size = cubemap.getSize();
+    std::vector<std::array<Eigen::Array4f, 9>> rowSums(6 * size);
+    utils::parallelFor(6 * size, numThreads, [&](int row) -> void {
+        const int face = row / size, y = row % size;
+        const Eigen::Array4f* texels = cubemap.getFace(0, face) + y * size;
+        std::array<Eigen::Array4f, 9>& sums = rowSums[row];
+        sums.fill(Eigen::Array4f::Zero());
+        for (int x = 0; x < size; x++) {
+            //Texel direction and solid angle
+            const float s = ((float)x + 0.5f) / (float)size, t = ((float)y + 0.5f) / (float)size;
+            const Eigen::Vector3f direction = Cubemap::getDirection(face, s, t);
+            const float length2 = direction.squaredNorm();
+            const float solidAngle = 4.f / (length2 * std::sqrt(length2) * (float)size * (float)size);
+
+            const std::array<float, 9> basis = evaluateBasis(direction / std::sqrt(length2));
+            const Eigen::Array4f radiance = texels[x] * solidAngle;
+            for (int i = 0; i < 9; i++)
+                sums[i] += basis[i] * radiance;
+        }
+    });
+
+    SphericalHarmonics sh;
+    for (const std::array<Eigen::Array4f, 9>& sums : rowSums)
+        for (int i = 0; i < 9; i++)
+            sh.coefficients[i] += sums[i];
+    return sh;
+}
+
+std::array<float, 9> SphericalHarmonics::evaluateBasis(const Eigen::Vector3f& direction) {
+    const float x = direction.x(), y = direction.y(), z = direction.z();
+    return {0.282095f,
+            0.488603f * y,
+            0.488603f * z,
+            0.488603f * x,
+            1.092548f * x * y,
+            1.092548f * y * z,
+            0.315392f * (3.f * z * z - 1.f),
+            1.092548f * x * z,
+            0.546274f * (x * x - y * y)};
+}
+
+Eigen::Array4f SphericalHarmonics::evaluateIrradiance(const Eigen::Vector3f& normal) const {
+    const std::array<Eigen::Array4f, 9> irradiance = getIrradianceCoefficients();
+    const std::array<float, 9> basis = evaluateBasis(normal.normalized());
+    Eigen::Array4f result = Eigen::Array4f::Zero();
+    for (int i = 0; i < 9; i++)
+        result += basis[i] * irradiance[i];
+    return result;
+}
+
+std::array<Eigen::Array4f, 9> SphericalHarmonics::getIrradianceCoefficients() const {
+    //Convolution with the clamped cosine per band (pi, 2pi/3, pi/4), divided by pi for a diffuse surface
+    const float bands[9] = {1.f, 2.f / 3.f, 2.f / 3.f, 2.f / 3.f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f};
+    std::array<Eigen::Array4f, 9> irradiance;
+    for (int i = 0; i < 9; i++)
+        irradiance[i] = bands[i] * coefficients[i];
+    return irradiance;
+}
+
+}  // namespace lenny::tools
@@ -2,8 +2,10 @@
 #include <lenny/tools/Utils.h>
 #include <sys/stat.h>
 
+#include <atomic>
 #include <ctime>
 #include <fstream>
+#include <thread>
 
 #if WIN32
 #include <windows.h>
@@ -119,6 +121,27 @@ void createDirectory(const std::string& dir) {
 #endif
 }
 
+void parallelFor(int count, int numThreads, const std::function<void(int)>& f) {
+    if (numThreads <= 0)
+        numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    std::atomic<int> next = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < std::min(numThreads, count); i++)
+        threads.emplace_back([&]() -> void {
+            for (int index = next++; index < count; index = next++)
+                f(index);
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+uint64_t hash(const void* data, size_t numBytes, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < numBytes; i++)
+        seed = (seed ^ bytes[i]) * 1099511628211ull;
+    return seed;
+}
+
 std::string getCurrentDateAndTime() {
     time_t now = time(nullptr);
     char name[80];
@@ -0,0 +1,112 @@
+#include <lenny/tools/Logger.h>
+#include <lenny/tools/SoftwareRasterizer.h>
+
+#include <cstring>
+#include <fstream>
+
+//Renders a fixed scene with the software rasterizer, without a window or GL context, and compares it with the golden image.
+//Run with --update to write the golden image after an intended change of the output.
+
+using namespace lenny;
+
+const std::string goldenPath = LENNY_TOOLS_TESTS_FOLDER "/data/SoftwareRasterizer.ppm";
+const int width = 160, height = 120;
+const double maxRMSE = 0.01;  //Leaves room for differences in floating point code generation
+
+tools::Cubemap createEnvironment() {
+    //Sky gradient above a darker horizon, with a warm side to make the reflections and the irradiance directional
+    const int size = 16;
+    tools::Cubemap cubemap(size);
+    for (int face = 0; face < 6; face++) {
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                const Eigen::Vector3f direction = tools::Cubemap::getDirection(face, ((float)x + 0.5f) / (float)size, ((float)y + 0.5f) / (float)size);
+                const float up = std::max(direction.y(), 0.f), warm = std::max(direction.x(), 0.f);
+                cubemap.getFace(0, face)[y * size + x] << 0.3f + 0.2f * up + 0.4f * warm, 0.35f + 0.3f * up, 0.4f + 0.5f * up, 1.f;
+            }
+        }
+    }
+    return cubemap;
+}
+
+tools::SoftwareRasterizer::Image render(const tools::Cubemap& environment) {
+    tools::SoftwareRasterizer rasterizer;
+    rasterizer.environment.cubemap = &environment;
+    rasterizer.environment.irradiance = tools::SphericalHarmonics::project(environment);
+
+    //Every kind of shape, one of them translucent in front of the others
+    rasterizer.drawPlane(Eigen::Vector3d::Zero(), Eigen::QuaternionD::Identity(), Eigen::Vector2d(6.0, 6.0), Eigen::Vector4d(0.6, 0.6, 0.6, 1.0));
+    rasterizer.drawCuboid(Eigen::Vector3d(-1.2, 0.4, 0.0), Eigen::QuaternionD(Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitY())),
+                          Eigen::Vector3d(0.6, 0.8, 0.6), Eigen::Vector4d(0.8, 0.3, 0.2, 1.0));
+    rasterizer.drawRoundedCuboid(Eigen::Vector3d(0.0, 0.35, -0.6), Eigen::QuaternionD::Identity(), Eigen::Vector3d(0.8, 0.7, 0.5), 0.15,
+                                 Eigen::Vector4d(0.2, 0.7, 0.3, 1.0));
+    rasterizer.drawRoundedPlane(Eigen::Vector3d(1.2, 0.01, 0.8), Eigen::QuaternionD::Identity(), Eigen::Vector2d(0.8, 0.6), 0.2,
+                                Eigen::Vector4d(0.9, 0.9, 0.2, 1.0));
+    rasterizer.drawCapsule(Eigen::Vector3d(1.2, 0.2, -0.4), Eigen::Vector3d(1.2, 0.9, -0.4), 0.15, Eigen::Vector4d(0.3, 0.4, 0.9, 1.0));
+    rasterizer.drawCone(Eigen::Vector3d(-0.2, 0.0, 0.9), Eigen::Vector3d(0.0, 0.6, 0.0), 0.25, Eigen::Vector4d(0.7, 0.5, 0.9, 1.0));
+    rasterizer.drawSphere(Eigen::Vector3d(0.3, 0.45, 0.4), 0.3, Eigen::Vector4d(0.9, 0.9, 0.9, 0.5));
+
+    const tools::SoftwareRasterizer::Camera camera =
+        tools::SoftwareRasterizer::getCamera(Eigen::Vector3f(2.5f, 2.0f, 3.5f), Eigen::Vector3f(0.f, 0.3f, 0.f), 0.8f, (float)width / (float)height);
+    return rasterizer.render(camera, width, height);
+}
+
+bool writeImage(const std::string& filePath, const tools::SoftwareRasterizer::Image& image) {
+    //Binary PPM with the top row first
+    std::ofstream file(filePath, std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (int y = height - 1; y >= 0; y--)
+        for (int x = 0; x < width; x++)
+            for (int c = 0; c < 3; c++)
+                file.put((char)std::lround(std::clamp(image[y * width + x][c], 0.f, 1.f) * 255.f));
+    return file.good();
+}
+
+bool readImage(const std::string& filePath, tools::SoftwareRasterizer::Image& image) {
+    std::ifstream file(filePath, std::ios::binary);
+    std::string format;
+    int fileWidth = 0, fileHeight = 0, maxValue = 0;
+    file >> format >> fileWidth >> fileHeight >> maxValue;
+    file.get();
+    if (!file || format != "P6" || fileWidth != width || fileHeight != height || maxValue != 255)
+        return false;
+    image.assign(width * height, Eigen::Array4f::Ones());
+    for (int y = height - 1; y >= 0; y--)
+        for (int x = 0; x < width; x++)
+            for (int c = 0; c < 3; c++)
+                image[y * width + x][c] = (float)(unsigned char)file.get() / 255.f;
+    return file.good();
+}
+
+int main(int argc, char** argv) {
+    const tools::Cubemap environment = createEnvironment();
+    const tools::SoftwareRasterizer::Image image = render(environment);
+
+    if (argc > 1 && std::strcmp(argv[1], "--update") == 0) {
+        if (!writeImage(goldenPath, image)) {
+            LENNY_LOG_WARNING("Could not write the golden image `%s`", goldenPath.c_str())
+            return 1;
+        }
+        LENNY_LOG_INFO("Updated the golden image `%s`", goldenPath.c_str())
+        return 0;
+    }
+
+    tools::SoftwareRasterizer::Image golden;
+    if (!readImage(goldenPath, golden)) {
+        LENNY_LOG_WARNING("Could not read the golden image `%s`", goldenPath.c_str())
+        return 1;
+    }
+
+    //Compared in the 8-bit range of the golden image
+    double sum = 0.0;
+    for (size_t i = 0; i < image.size(); i++)
+        for (int c = 0; c < 3; c++)
+            sum += std::pow(std::round(std::clamp((double)image[i][c], 0.0, 1.0) * 255.0) / 255.0 - (double)golden[i][c], 2.0);
+    const double rmse = std::sqrt(sum / (3.0 * (double)image.size()));
+    if (!(rmse <= maxRMSE)) {  //Also fails for NaN
+        LENNY_LOG_WARNING("RMSE to the golden image is %.4f, more than %.4f (write the image with --update to inspect it)", rmse, maxRMSE)
+        return 1;
+    }
+    LENNY_LOG_INFO("RMSE to the golden image: %.4f", rmse)
+    return 0;
+}